@@ -5,6 +5,7 @@
 #include <nexus/detail/assertions.hh>
 #include <nexus/detail/exception.hh>
 #include <nexus/detail/log.hh>
+#include <nexus/detail/trace_serialize.hh>
 #include <nexus/tests/Test.hh>
 
 #include <clean-core/defer.hh>
@@ -88,10 +89,12 @@ namespace nx
 {
 void write_xml_results(cc::string filename);
 void write_xml_results_sentinel(cc::string filename);
+void write_mct_profiles(cc::string filename, cc::span<Test* const> tests);
 }
 
 nx::App* nx::detail::get_current_app() { return curr_app(); }
 nx::Test* nx::detail::get_current_test() { return curr_test(); }
+void nx::detail::set_current_test(Test* t) { curr_test() = t; }
 
 bool& nx::detail::is_silenced()
 {
@@ -122,6 +125,38 @@ void nx::Nexus::applyCmdArgs(int argc, char** argv)
         if (s == "--no-endless")
             mNoEndless = true;
 
+        if (s == "--fork-server")
+            mForceForkServer = true;
+
+        if (s == "--mct-swarm")
+            mForceMctSwarm = true;
+
+        if (s == "--mct-threads")
+        {
+            if (i + 1 < argc)
+            {
+                int n;
+                if (cc::from_string(cc::string_view(argv[i + 1]), n) && n >= 0)
+                    mForceMctThreads = n;
+                else
+                    RICH_LOG_WARN("invalid thread count '%s' for --mct-threads", argv[i + 1]);
+                ++i;
+            }
+        }
+
+        if (s == "--mct-scale")
+        {
+            if (i + 1 < argc)
+            {
+                double f;
+                if (cc::from_string(cc::string_view(argv[i + 1]), f) && f > 0)
+                    mMctScale = f;
+                else
+                    RICH_LOG_WARN("invalid scale '%s' for --mct-scale", argv[i + 1]);
+                ++i;
+            }
+        }
+
         if (s == "--repr")
         {
             if (i + 1 < argc)
@@ -131,6 +166,42 @@ void nx::Nexus::applyCmdArgs(int argc, char** argv)
             }
         }
 
+        if (s == "--mct-profile")
+        {
+            if (i + 1 < argc)
+            {
+                mMctProfileFile = argv[i + 1];
+                ++i;
+            }
+        }
+
+        if (s == "--save-traces")
+        {
+            if (i + 1 < argc)
+            {
+                mTraceSaveDir = argv[i + 1];
+                ++i;
+            }
+        }
+
+        if (s == "--capture-traces")
+        {
+            if (i + 1 < argc)
+            {
+                mTraceCaptureDir = argv[i + 1];
+                ++i;
+            }
+        }
+
+        if (s == "--bench-trace")
+        {
+            if (i + 1 < argc)
+            {
+                mBenchTraceFile = argv[i + 1];
+                ++i;
+            }
+        }
+
         if (s == "--group" || s == "-g")
         {
             if (i + 1 < argc)
@@ -168,7 +239,24 @@ int nx::Nexus::run()
         RICH_LOG(R"(  --help        shows this help)");
         RICH_LOG(R"(  --endless     runs fuzz and mct tests in endless mode)");
         RICH_LOG(R"(  --no-endless  errors if any test would be run in endless mode (useful for CI))");
+        RICH_LOG(R"(  --fork-server runs fuzz tests in forked child processes)");
+        RICH_LOG(R"(                (survives crashes and hangs, POSIX only))");
+        RICH_LOG(R"(  --mct-threads n)");
+        RICH_LOG(R"(                runs monte carlo test sessions on n threads (0 = all hardware threads))");
+        RICH_LOG(R"(  --mct-swarm   runs monte carlo test sessions with random subsets of the ops (swarm testing))");
+        RICH_LOG(R"(  --mct-scale f scales monte carlo session lengths (budgets and execute_at_least counts) by f)");
         RICH_LOG(R"(  --repr s      runs a test reproduction (i.e. similar to reproduce(s)))");
+        RICH_LOG(R"(                '@file' reads it from a trace file)");
+        RICH_LOG(R"(  --mct-profile file)");
+        RICH_LOG(R"(                profiles all monte carlo tests and writes the profiles as json into file)");
+        RICH_LOG(R"(  --save-traces dir)");
+        RICH_LOG(R"(                writes failing monte carlo traces into dir (replay via --repr @dir/name.nxtrace))");
+        RICH_LOG(R"(  --capture-traces dir)");
+        RICH_LOG(R"(                writes the sampled monte carlo session of each passing test into dir)");
+        RICH_LOG(R"(                (as workloads for --bench-trace))");
+        RICH_LOG(R"(  --bench-trace file)");
+        RICH_LOG(R"(                replays a monte carlo trace file as a benchmark of the selected test)");
+        RICH_LOG(R"(                (per-op latencies and throughput, no checks))");
         RICH_LOG(R"(  --xml file    writes the test results into the given file in JUnit xml style)");
         RICH_LOG(R"(  "test name"   runs all tests named "test name" (quotation marks optional if no space in name))");
         RICH_LOG("");
@@ -212,6 +300,30 @@ int nx::Nexus::run()
     if (!mXmlOutputFile.empty())
         nx::write_xml_results_sentinel(mXmlOutputFile);
 
+    // reproduction from trace file
+    if (!mForceReproduction.empty() && mForceReproduction[0] == '@')
+    {
+        auto const filename = cc::string(cc::string_view(mForceReproduction).subview(1));
+        mForceReproduction = detail::trace_read_file(filename);
+        if (mForceReproduction.empty())
+        {
+            LOG_ERROR("could not read trace file '%s'", filename);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // benchmark workload from trace file
+    cc::string bench_trace;
+    if (!mBenchTraceFile.empty())
+    {
+        bench_trace = detail::trace_read_file(mBenchTraceFile);
+        if (bench_trace.empty())
+        {
+            LOG_ERROR("could not read trace file '%s'", mBenchTraceFile);
+            return EXIT_FAILURE;
+        }
+    }
+
     // tests
     auto const& tests = detail::get_all_tests();
 
@@ -260,6 +372,30 @@ int nx::Nexus::run()
         if (mForceEndless)
             t->mIsEndless = true;
 
+        if (mForceForkServer)
+            t->mIsForkServer = true;
+
+        if (mForceMctSwarm)
+            t->mIsMctSwarm = true;
+
+        if (mForceMctThreads >= 0)
+            t->mMctThreads = mForceMctThreads;
+
+        if (mMctScale > 0)
+            t->mMctScale = mMctScale;
+
+        t->mTraceSaveDir = mTraceSaveDir;
+        t->mTraceCaptureDir = mTraceCaptureDir;
+
+        if (!bench_trace.empty())
+        {
+            t->mIsMctBenchmark = true;
+            t->mBenchTrace = bench_trace;
+        }
+
+        if (!mMctProfileFile.empty())
+            t->mIsMctProfile = true;
+
         if (t->mIsEndless && mNoEndless)
         {
             LOG_ERROR("test '%s' would be run in endless more but --no-endless is specified", t->name());
@@ -279,6 +415,13 @@ int nx::Nexus::run()
         tests_to_run.push_back(t.get());
     }
 
+    // a trace is only meaningful for the test it was recorded for
+    if (!bench_trace.empty() && tests_to_run.size() != 1)
+    {
+        LOG_ERROR("--bench-trace needs exactly one selected test (the one the trace was recorded for), but %s are selected", tests_to_run.size());
+        return EXIT_FAILURE;
+    }
+
     RICH_LOG("version %s", version);
     RICH_LOG("run with '--help' for options");
     RICH_LOG("detected %s %s", tests.size(), tests.size() == 1 ? "test" : "tests");
@@ -379,6 +522,9 @@ int nx::Nexus::run()
             nx::write_xml_results(mXmlOutputFile);
     };
 
+    if (!mMctProfileFile.empty())
+        nx::write_mct_profiles(mMctProfileFile, tests_to_run);
+
     if (tests.empty())
     {
         RICH_LOG_WARN("no tests found/selected");
@@ -531,3 +677,33 @@ void nx::write_xml_results_sentinel(cc::string filename)
 
     std::ofstream(filename.c_str()) << xml.c_str();
 }
+
+void nx::write_mct_profiles(cc::string filename, cc::span<Test* const> tests)
+{
+    cc::string json;
+    json += "{\"tests\":[";
+    auto first = true;
+    for (auto const* t : tests)
+    {
+        if (t->mctProfileJson().empty())
+            continue;
+
+        if (!first)
+            json += ',';
+        first = false;
+
+        // test names are identifiers in practice, only quotes and backslashes need escaping
+        cc::string name;
+        for (auto c : cc::string_view(t->name()))
+        {
+            if (c == '"' || c == '\\')
+                name += '\\';
+            name += c;
+        }
+        json += "{\"name\":\"" + name + "\",\"profile\":" + t->mctProfileJson() + "}";
+    }
+    json += "]}";
+
+    std::ofstream(filename.c_str()) << json.c_str();
+    LOG("wrote mct profiles to '%s'", filename);
+}
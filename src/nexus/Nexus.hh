@@ -19,7 +19,15 @@ private:
     bool mPrintHelp = false;
     bool mForceEndless = false;
     bool mNoEndless = false;
+    bool mForceForkServer = false;
+    bool mForceMctSwarm = false;
+    int mForceMctThreads = -1; // -1 means not set
+    double mMctScale = -1;     // -1 means not set
     cc::string mForceReproduction;
+    cc::string mTraceSaveDir;
+    cc::string mTraceCaptureDir;
+    cc::string mBenchTraceFile;
+    cc::string mMctProfileFile;
     cc::string mXmlOutputFile;
     int mTestArgC = 0;
     char const* const* mTestArgV = nullptr;
@@ -0,0 +1,244 @@
+#include "bulk_rng.hh"
+
+#include <cmath>
+
+namespace
+{
+inline uint32_t rotl(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+
+// calls set(i, raw) for every output, generating 8 values at a time
+template <class F>
+void generate(nx::bulk_rng& rng, size_t count, F&& set)
+{
+    uint32_t block[nx::bulk_rng::lanes];
+    size_t i = 0;
+    for (; i + nx::bulk_rng::lanes <= count; i += nx::bulk_rng::lanes)
+    {
+        rng.next(block);
+        for (auto l = 0; l < nx::bulk_rng::lanes; ++l)
+            set(i + l, block[l]);
+    }
+    if (i < count)
+    {
+        rng.next(block);
+        for (auto l = 0; i < count; ++i, ++l)
+            set(i, block[l]);
+    }
+}
+
+// uniform in [0, range) via multiply-shift, range == 0 means full 32 bit range
+inline uint32_t scale_u32(uint32_t r, uint64_t range) { return range == 0 ? r : uint32_t((uint64_t(r) * range) >> 32); }
+
+// high 64 bits of the 128 bit product (portable, no __int128)
+inline uint64_t mul_hi_u64(uint64_t a, uint64_t b)
+{
+    auto const a_lo = a & 0xFFFFFFFFu;
+    auto const a_hi = a >> 32;
+    auto const b_lo = b & 0xFFFFFFFFu;
+    auto const b_hi = b >> 32;
+
+    auto const lo_lo = a_lo * b_lo;
+    auto const hi_lo = a_hi * b_lo;
+    auto const lo_hi = a_lo * b_hi;
+    auto const hi_hi = a_hi * b_hi;
+
+    auto const mid = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFu) + lo_hi;
+    return hi_hi + (hi_lo >> 32) + (mid >> 32);
+}
+
+// uniform in [0, range) via multiply-shift, range == 0 means full 64 bit range
+inline uint64_t scale_u64(uint64_t r, uint64_t range) { return range == 0 ? r : mul_hi_u64(r, range); }
+
+// min + u * (max - min) can round up to max, upper is the largest value below max
+template <class T>
+T clamp_below(T v, T upper)
+{
+    return v < upper ? v : upper;
+}
+
+inline float to_unit_float(uint32_t r) { return float(r >> 8) * (1.0f / 16777216.0f); }
+inline double to_unit_double(uint32_t hi, uint32_t lo) { return double((uint64_t(hi) << 21) ^ (lo >> 11)) * (1.0 / 9007199254740992.0); }
+}
+
+nx::bulk_rng::bulk_rng(tg::rng& rng)
+{
+    for (auto l = 0; l < lanes; ++l)
+    {
+        s0[l] = uint32_t(rng());
+        s1[l] = uint32_t(rng());
+        s2[l] = uint32_t(rng());
+        s3[l] = uint32_t(rng());
+
+        // xoshiro must not be seeded with all zeros
+        if ((s0[l] | s1[l] | s2[l] | s3[l]) == 0)
+            s0[l] = 1;
+    }
+}
+
+void nx::bulk_rng::next(uint32_t (&out)[lanes])
+{
+    // lanes are independent, so this loop is vectorized
+    for (auto l = 0; l < lanes; ++l)
+    {
+        out[l] = rotl(s1[l] * 5, 7) * 9;
+
+        auto const t = s1[l] << 9;
+        s2[l] ^= s0[l];
+        s3[l] ^= s1[l];
+        s1[l] ^= s2[l];
+        s0[l] ^= s3[l];
+        s2[l] ^= t;
+        s3[l] = rotl(s3[l], 11);
+    }
+}
+
+void nx::bulk_rng::fill_uniform(cc::span<int32_t> out, int32_t min, int32_t max)
+{
+    CC_CONTRACT(min <= max);
+    auto const range = uint64_t(int64_t(max) - int64_t(min) + 1);
+    generate(*this, out.size(), [&](size_t i, uint32_t r) { out[i] = int32_t(int64_t(min) + scale_u32(r, range == (uint64_t(1) << 32) ? 0 : range)); });
+}
+
+void nx::bulk_rng::fill_uniform(cc::span<uint32_t> out, uint32_t min, uint32_t max)
+{
+    CC_CONTRACT(min <= max);
+    auto const range = uint64_t(max) - uint64_t(min) + 1;
+    generate(*this, out.size(), [&](size_t i, uint32_t r) { out[i] = min + scale_u32(r, range == (uint64_t(1) << 32) ? 0 : range); });
+}
+
+void nx::bulk_rng::fill_uniform(cc::span<int64_t> out, int64_t min, int64_t max)
+{
+    CC_CONTRACT(min <= max);
+    auto const range = uint64_t(max) - uint64_t(min) + 1; // 0 means full range
+
+    // two 32 bit draws per value
+    uint32_t hi = 0;
+    generate(*this, out.size() * 2,
+             [&](size_t i, uint32_t r)
+             {
+                 if (i % 2 == 0)
+                 {
+                     hi = r;
+                     return;
+                 }
+                 auto const v = (uint64_t(hi) << 32) | r;
+                 out[i / 2] = int64_t(uint64_t(min) + scale_u64(v, range));
+             });
+}
+
+void nx::bulk_rng::fill_components(cc::span<int32_t> flat, int dims, int32_t const* min, int32_t const* max)
+{
+    for (auto c = 0; c < dims; ++c)
+        CC_CONTRACT(min[c] <= max[c]);
+
+    generate(*this, flat.size(),
+             [&](size_t i, uint32_t r)
+             {
+                 auto const c = int(i % dims);
+                 auto const range = uint64_t(int64_t(max[c]) - int64_t(min[c]) + 1);
+                 flat[i] = int32_t(int64_t(min[c]) + scale_u32(r, range == (uint64_t(1) << 32) ? 0 : range));
+             });
+}
+
+void nx::bulk_rng::fill_components(cc::span<int64_t> flat, int dims, int64_t const* min, int64_t const* max)
+{
+    for (auto c = 0; c < dims; ++c)
+        CC_CONTRACT(min[c] <= max[c]);
+
+    // two 32 bit draws per value
+    uint32_t hi = 0;
+    generate(*this, flat.size() * 2,
+             [&](size_t i, uint32_t r)
+             {
+                 if (i % 2 == 0)
+                 {
+                     hi = r;
+                     return;
+                 }
+                 auto const c = int(i / 2 % dims);
+                 auto const range = uint64_t(max[c]) - uint64_t(min[c]) + 1; // 0 means full range
+                 auto const v = (uint64_t(hi) << 32) | r;
+                 flat[i / 2] = int64_t(uint64_t(min[c]) + scale_u64(v, range));
+             });
+}
+
+void nx::bulk_rng::fill_uniform(cc::span<uint8_t> out, uint8_t min, uint8_t max)
+{
+    CC_CONTRACT(min <= max);
+    auto const range = uint64_t(max) - uint64_t(min) + 1;
+    generate(*this, out.size(), [&](size_t i, uint32_t r) { out[i] = uint8_t(min + scale_u32(r, range)); });
+}
+
+void nx::bulk_rng::fill_uniform(cc::span<bool> out)
+{
+    generate(*this, out.size(), [&](size_t i, uint32_t r) { out[i] = (r >> 31) != 0; });
+}
+
+void nx::bulk_rng::fill_uniform(cc::span<float> out, float min, float max)
+{
+    CC_CONTRACT(min < max);
+    auto const d = max - min;
+    auto const upper = std::nextafter(max, min);
+    generate(*this, out.size(), [&](size_t i, uint32_t r) { out[i] = clamp_below(min + to_unit_float(r) * d, upper); });
+}
+
+void nx::bulk_rng::fill_uniform(cc::span<double> out, double min, double max)
+{
+    CC_CONTRACT(min < max);
+    auto const d = max - min;
+    auto const upper = std::nextafter(max, min);
+    uint32_t hi = 0;
+    generate(*this, out.size() * 2,
+             [&](size_t i, uint32_t r)
+             {
+                 if (i % 2 == 0)
+                     hi = r;
+                 else
+                     out[i / 2] = clamp_below(min + to_unit_double(hi, r) * d, upper);
+             });
+}
+
+void nx::bulk_rng::fill_normal(cc::span<float> out, float mean, float stddev)
+{
+    // box-muller on pairs of uniforms
+    auto constexpr tau = 6.283185307179586f;
+    uint32_t r0 = 0;
+    generate(*this, (out.size() + 1) / 2 * 2,
+             [&](size_t i, uint32_t r)
+             {
+                 if (i % 2 == 0)
+                 {
+                     r0 = r;
+                     return;
+                 }
+                 auto const u0 = 1.0f - to_unit_float(r0); // (0, 1]
+                 auto const u1 = to_unit_float(r);
+                 auto const m = std::sqrt(-2.0f * std::log(u0)) * stddev;
+                 out[i - 1] = mean + m * std::cos(tau * u1);
+                 if (i < out.size())
+                     out[i] = mean + m * std::sin(tau * u1);
+             });
+}
+
+void nx::bulk_rng::fill_normal(cc::span<double> out, double mean, double stddev)
+{
+    // box-muller on pairs of uniforms
+    auto constexpr tau = 6.283185307179586;
+    uint32_t r[3] = {};
+    generate(*this, (out.size() + 1) / 2 * 4,
+             [&](size_t i, uint32_t ri)
+             {
+                 if (i % 4 != 3)
+                 {
+                     r[i % 4] = ri;
+                     return;
+                 }
+                 auto const u0 = 1.0 - to_unit_double(r[0], r[1]); // (0, 1]
+                 auto const u1 = to_unit_double(r[2], ri);
+                 auto const m = std::sqrt(-2.0 * std::log(u0)) * stddev;
+                 auto const o = i / 4 * 2;
+                 out[o] = mean + m * std::cos(tau * u1);
+                 if (o + 1 < out.size())
+                     out[o + 1] = mean + m * std::sin(tau * u1);
+             });
+}
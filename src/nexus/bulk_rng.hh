@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+#include <clean-core/assert.hh>
+#include <clean-core/span.hh>
+
+#include <typed-geometry/feature/random.hh>
+#include <typed-geometry/tg-lean.hh>
+
+#include <nexus/detail/api.hh>
+
+namespace nx
+{
+namespace detail
+{
+template <class T>
+struct nondeduced
+{
+    using type = T;
+};
+}
+
+/**
+ * Fast generator for filling large buffers in fuzz tests
+ *
+ * Runs 8 independent xoshiro128** lanes in struct-of-arrays layout,
+ * so generation vectorizes (one AVX2 register per state word) instead of calling the scalar rng per value.
+ * It is seeded from (and advances) a tg::rng, so the same fuzz seed always produces the same data on every platform
+ * (except for fill_normal, which uses std::log, std::cos and std::sin and can differ in the last bits between standard libraries).
+ *
+ * Usage:
+ *   FUZZ_TEST("my fuzz test")(tg::rng& rng)
+ *   {
+ *       cc::vector<int> data;
+ *       data.resize(100'000);
+ *       nx::bulk_rng(rng).fill_uniform(data, -10, 10);
+ *       ...
+ *   }
+ *
+ * NOTE: integer ranges use multiply-shift without rejection (negligible bias for fuzzing purposes)
+ */
+struct NX_API bulk_rng
+{
+    static constexpr int lanes = 8;
+
+    explicit bulk_rng(tg::rng& rng);
+
+    /// fills with uniform values in [min, max] (inclusive)
+    void fill_uniform(cc::span<int32_t> out, int32_t min, int32_t max);
+    void fill_uniform(cc::span<uint32_t> out, uint32_t min, uint32_t max);
+    void fill_uniform(cc::span<int64_t> out, int64_t min, int64_t max);
+    void fill_uniform(cc::span<uint8_t> out, uint8_t min, uint8_t max);
+    void fill_uniform(cc::span<bool> out);
+
+    /// fills with uniform values in [min, max) (requires min < max)
+    void fill_uniform(cc::span<float> out, float min, float max);
+    void fill_uniform(cc::span<double> out, double min, double max);
+
+    /// fills with normally distributed values (box-muller)
+    void fill_normal(cc::span<float> out, float mean = 0, float stddev = 1);
+    void fill_normal(cc::span<double> out, double mean = 0, double stddev = 1);
+
+    /// fills with uniform vectors/positions inside the box [min, max)
+    /// (float and double components, int32 and int64 components are in [min, max] like the scalar fills)
+    template <int D, class ScalarT>
+    void fill_uniform(typename detail::nondeduced<cc::span<tg::vec<D, ScalarT>>>::type out, tg::vec<D, ScalarT> min, tg::vec<D, ScalarT> max)
+    {
+        fill_box<D, ScalarT>(out, min, max);
+    }
+    template <int D, class ScalarT>
+    void fill_uniform(typename detail::nondeduced<cc::span<tg::pos<D, ScalarT>>>::type out, tg::pos<D, ScalarT> min, tg::pos<D, ScalarT> max)
+    {
+        fill_box<D, ScalarT>(out, min, max);
+    }
+
+    /// next 8 raw values (one per lane)
+    void next(uint32_t (&out)[lanes]);
+
+private:
+    template <int D, class ScalarT, class VecT>
+    void fill_box(cc::span<VecT> out, VecT const& min, VecT const& max)
+    {
+        static_assert(sizeof(VecT) == D * sizeof(ScalarT), "unexpected vector layout");
+
+        auto flat = cc::span<ScalarT>(reinterpret_cast<ScalarT*>(out.data()), out.size() * D);
+        if constexpr (std::is_floating_point_v<ScalarT>)
+        {
+            // fill all components with [0, 1) and rescale per component
+            // (clamped, since the rescaled value can round up to max)
+            fill_uniform(flat, ScalarT(0), ScalarT(1));
+            for (auto c = 0; c < D; ++c)
+            {
+                CC_CONTRACT(min[c] < max[c]);
+                auto const d = max[c] - min[c];
+                auto const upper = std::nextafter(max[c], min[c]);
+                for (size_t i = 0; i < out.size(); ++i)
+                {
+                    auto const v = min[c] + flat[i * D + c] * d;
+                    flat[i * D + c] = v < upper ? v : upper;
+                }
+            }
+        }
+        else
+        {
+            static_assert(std::is_same_v<ScalarT, int32_t> || std::is_same_v<ScalarT, int64_t>, "only float, double, int32 and int64 components are supported");
+
+            ScalarT mins[D];
+            ScalarT maxs[D];
+            for (auto c = 0; c < D; ++c)
+            {
+                mins[c] = min[c];
+                maxs[c] = max[c];
+            }
+            fill_components(flat, D, mins, maxs);
+        }
+    }
+
+    /// integer boxes: component i % dims of flat is uniform in [min[i % dims], max[i % dims]]
+    void fill_components(cc::span<int32_t> flat, int dims, int32_t const* min, int32_t const* max);
+    void fill_components(cc::span<int64_t> flat, int dims, int64_t const* min, int64_t const* max);
+
+    uint32_t s0[lanes];
+    uint32_t s1[lanes];
+    uint32_t s2[lanes];
+    uint32_t s3[lanes];
+};
+}
@@ -60,6 +60,106 @@ static constexpr struct verbose_t
 {
 } verbose;
 
+/// fuzz tests: runs iterations in forked child processes (POSIX only)
+/// crashes and hangs are attributed to the exact seed and fuzzing continues with a fresh child
+/// (an iteration counts as hanging after 1s)
+static constexpr struct fork_server_t
+{
+} fork_server;
+
+/// fuzz tests: looks for the inputs that maximize the cost of an iteration instead of for failing ones
+/// keeps a corpus of the costliest inputs and mutates them by shifting their rng draw stream by a few draws
+/// cost is measured in cycles unless the test reports it via nx::fuzz_cost (iterations without a report then have cost 0)
+/// reports the costliest inputs found together with their reproduction
+static constexpr struct perf_fuzz_t
+{
+} perf_fuzz;
+
+/// fuzz tests: a run ends after the given number of iterations or cycles, whichever is reached first
+/// (defaults to 1000 iterations and 10M cycles, ignored for endless tests)
+struct fuzz_budget
+{
+    explicit fuzz_budget(int iterations, size_t cycles = 10'000'000) : iterations(iterations), cycles(cycles) {}
+    int iterations;
+    size_t cycles;
+};
+
+/// monte carlo tests: enumerates all operation sequences up to the given length instead of sampling them
+/// (ops taking a tg::rng are enumerated with rng_choices different seeds)
+/// the sequences are replayed on all hardware threads unless mct_threads(n) is given
+/// NOTE: only for monte carlo tests, the draws of the tg::rng of a FUZZ_TEST cannot be enumerated
+struct exhaustive
+{
+    explicit exhaustive(int depth, int rng_choices = 2) : depth(depth), rng_choices(rng_choices) {}
+    int depth;
+    int rng_choices;
+};
+
+/// monte carlo tests: runs independent sessions on n threads in parallel (0 = one per hardware thread)
+/// each thread has its own machine and seeds derived from the test seed (thread 0 uses the seed itself)
+/// exhaustive checks and the replays of minimization are spread over the same number of threads
+/// (without mct_threads, sessions and minimization are sequential and exhaustive checks use all hardware threads)
+/// NOTE: tests touching global state can opt out via MonteCarloTest::disableParallelSessions()
+struct mct_threads
+{
+    explicit mct_threads(int n) : n(n) {}
+    int n;
+};
+
+/// monte carlo tests: a session ends after n ops instead of once every op reached its execute_at_least count
+/// ops are then sampled cost-aware, i.e. every op gets a similar share of the session time (scaled by its weight)
+/// NOTE: can be combined with mct_time (whichever is reached first) and is scaled by '--mct-scale f'
+struct mct_ops
+{
+    explicit mct_ops(int n) : n(n) {}
+    int n;
+};
+
+/// monte carlo tests: a session ends after the given wall time (in ms), see mct_ops
+struct mct_time
+{
+    explicit mct_time(double ms) : ms(ms) {}
+    double ms;
+};
+
+/// monte carlo tests: profiles the sampled sessions and prints the result after the run
+/// per op: executions, time (total, mean, max), precondition rejection rate and fallbacks to other ops
+/// per type: max and mean value pool size over the course of a session
+/// NOTE: also enabled via '--mct-profile file.json', which additionally writes all profiles as json
+static constexpr struct mct_profile_t
+{
+} mct_profile;
+
+/// monte carlo tests: times each op on the reference and on every implementation of an equivalence while sampling
+/// reports the speedup of each implementation with 95% confidence intervals
+/// per op (geometric mean of the paired reference / implementation times) and in total (ratio of the total times)
+/// max_slowdown > 0: fails if an implementation op is slower than the reference by more than that factor
+///                   (e.g. 1.25 fails ops whose whole speedup interval lies below 0.8)
+/// NOTE: ops are timed individually, so very cheap ops mostly measure timer overhead
+struct mct_speedup
+{
+    explicit mct_speedup(double max_slowdown = 0) : max_slowdown(max_slowdown) {}
+    double max_slowdown = 0;
+};
+
+/// monte carlo tests: benchmarks the workload of a sampled session instead of only testing it
+/// the session trace is replayed through the fast replay path (timing only, no invariants)
+/// and per-op latencies and total throughput are reported
+/// NOTE: use mct_ops(n) for longer workloads and seed(...) or '--bench-trace file' for reproducible ones
+///       (see MONTE_CARLO_BENCHMARK)
+static constexpr struct mct_benchmark_t
+{
+} mct_benchmark;
+
+/// monte carlo tests: swarm testing, each session only uses a random subset of the ops
+/// every op that is not a generator (i.e. takes an arg of its return type or returns nothing) is disabled with probability 1/2,
+/// so that bugs that need some ops to be absent (e.g. no 'clear' lets containers grow large) are found more often
+/// the configuration is stored in the trace and printed for failing sessions
+/// NOTE: also enabled for all tests via '--mct-swarm'
+static constexpr struct mct_swarm_t
+{
+} mct_swarm;
+
 /// use a specific seed
 struct seed
 {
@@ -0,0 +1,65 @@
+#include "parallel.hh"
+
+#include <thread>
+
+#include <clean-core/vector.hh>
+
+#include <nexus/check.hh>
+#include <nexus/tests/Test.hh>
+
+int nx::detail::hardware_threads()
+{
+    auto const n = int(std::thread::hardware_concurrency());
+    return n < 1 ? 1 : n;
+}
+
+void nx::detail::run_parallel(int num_threads, cc::unique_function<void(int)> const& job)
+{
+    CC_CONTRACT(num_threads >= 1);
+
+    if (num_threads == 1)
+    {
+        job(0);
+        return;
+    }
+
+    struct worker_counts
+    {
+        int num_checks = 0;
+        int num_failed_checks = 0;
+    };
+
+    auto const test = get_current_test();
+    auto const silenced = is_silenced();
+    auto const terminate = always_terminate();
+    auto counts = cc::vector<worker_counts>::defaulted(num_threads);
+
+    cc::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+    for (auto i = 1; i < num_threads; ++i)
+        threads.emplace_back(
+            [&, i]
+            {
+                set_current_test(test);
+                is_silenced() = silenced;
+                always_terminate() = terminate;
+                number_of_assertions() = 0;
+                number_of_failed_assertions() = 0;
+
+                job(i);
+
+                counts[i].num_checks = number_of_assertions();
+                counts[i].num_failed_checks = number_of_failed_assertions();
+            });
+
+    job(0);
+
+    for (auto& t : threads)
+        t.join();
+
+    for (auto const& c : counts)
+    {
+        number_of_assertions() += c.num_checks;
+        number_of_failed_assertions() += c.num_failed_checks;
+    }
+}
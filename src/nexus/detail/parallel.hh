@@ -0,0 +1,18 @@
+#pragma once
+
+#include <clean-core/unique_function.hh>
+
+namespace nx::detail
+{
+/// number of hardware threads (at least 1)
+int hardware_threads();
+
+/// executes job(thread_idx) on num_threads threads and returns when all are done
+/// the calling thread is used as thread 0
+///
+/// worker threads inherit the current test, is_silenced() and always_terminate() from the caller
+/// and their assertion counts are added to the caller after joining
+///
+/// NOTE: job must not let exceptions escape
+void run_parallel(int num_threads, cc::unique_function<void(int)> const& job);
+}
@@ -1,79 +1,240 @@
 #include "trace_serialize.hh"
 
+#include <fstream>
+#include <iterator>
+
 #include <clean-core/span.hh>
 #include <clean-core/string.hh>
 #include <clean-core/string_view.hh>
 #include <clean-core/vector.hh>
 
-static constexpr cc::string_view trace_charset = "-0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+namespace
+{
+// legacy text format: base-63 digits, '.' and ':' prefix 2- and 3-digit values
+constexpr char const legacy_charset[] = "-0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+constexpr int legacy_ccnt = int(sizeof(legacy_charset)) - 1;
+
+// current text format: '_' + url-safe base64 of the binary form (no padding)
+constexpr char const armor_charset[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+constexpr char armor_prefix = '_';
+
+constexpr char const file_magic[] = {'N', 'X', 'T', 'R'};
+constexpr int file_magic_size = int(sizeof(file_magic));
+
+// header byte of the binary form
+constexpr uint8_t binary_version = 1;
+constexpr uint8_t binary_flag_compressed = 0x01;
+
+constexpr int lz_min_match = 4;
+constexpr int lz_hash_bits = 12;
+
+/// char -> digit lookup instead of scanning the charset
+struct char_table
+{
+    int8_t digit[256] = {};
+
+    constexpr char_table(char const* chars, int cnt)
+    {
+        for (auto& d : digit)
+            d = -1;
+        for (auto i = 0; i < cnt; ++i)
+            digit[uint8_t(chars[i])] = int8_t(i);
+    }
+
+    int operator[](char c) const
+    {
+        auto const d = digit[uint8_t(c)];
+        CC_ASSERT(d >= 0 && "invalid character in trace");
+        return d;
+    }
+};
+
+constexpr char_table legacy_table(legacy_charset, legacy_ccnt);
+constexpr char_table armor_table(armor_charset, 64);
 
-static int find_char(char c)
+void write_varint(cc::vector<uint8_t>& out, uint32_t v)
 {
-    for (auto i = 0; i < int(trace_charset.size()); ++i)
-        if (trace_charset[i] == c)
-            return i;
-    CC_ASSERT(false && "not found");
-    return -1;
+    while (v >= 0x80)
+    {
+        out.push_back(uint8_t(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(uint8_t(v));
 }
 
-cc::string nx::detail::trace_encode(cc::span<const int> data)
+uint32_t read_varint(cc::span<uint8_t const> data, size_t& pos)
 {
-    cc::string s;
+    uint32_t v = 0;
+    for (auto shift = 0;; shift += 7)
+    {
+        CC_ASSERT(pos < data.size() && shift < 35 && "truncated or corrupt trace");
+        auto const b = data[pos++];
+        v |= uint32_t(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+}
 
-    auto constexpr ccnt = int(trace_charset.size());
+// greedy LZ77 with a single-entry hash table
+// layout: [size] then tokens [#literals][literals][match length - min][distance], the last token has no match
+cc::vector<uint8_t> lz_compress(cc::span<uint8_t const> in)
+{
+    cc::vector<uint8_t> out;
+    write_varint(out, uint32_t(in.size()));
 
-    for (auto i : data)
+    auto const n = int(in.size());
+    auto last_pos = cc::vector<int>::filled(1 << lz_hash_bits, -1);
+    auto const hash_at = [&](int i)
     {
-        CC_ASSERT(i >= -1);
+        auto const v = uint32_t(in[i]) | uint32_t(in[i + 1]) << 8 | uint32_t(in[i + 2]) << 16 | uint32_t(in[i + 3]) << 24;
+        return int((v * 2654435761u) >> (32 - lz_hash_bits));
+    };
+    auto const write_literals = [&](int start, int end)
+    {
+        write_varint(out, uint32_t(end - start));
+        for (auto i = start; i < end; ++i)
+            out.push_back(in[i]);
+    };
+
+    auto lit_start = 0;
+    auto i = 0;
+    while (i + lz_min_match <= n)
+    {
+        auto const h = hash_at(i);
+        auto const cand = last_pos[h];
+        last_pos[h] = i;
+
+        auto len = 0;
+        if (cand >= 0)
+            while (i + len < n && in[cand + len] == in[i + len])
+                ++len;
 
-        i += 1;
-        if (i < ccnt)
-            s += trace_charset[i];
-        else if (i < ccnt * ccnt)
+        if (len < lz_min_match)
         {
-            s += '.';
-            s += trace_charset[i % ccnt];
-            s += trace_charset[i / ccnt];
+            ++i;
+            continue;
         }
-        else if (i < ccnt * ccnt * ccnt)
+
+        write_literals(lit_start, i);
+        write_varint(out, uint32_t(len - lz_min_match));
+        write_varint(out, uint32_t(i - cand));
+
+        for (auto j = i + 1; j < i + len && j + lz_min_match <= n; ++j)
+            last_pos[hash_at(j)] = j;
+
+        i += len;
+        lit_start = i;
+    }
+    write_literals(lit_start, n);
+
+    return out;
+}
+
+cc::vector<uint8_t> lz_decompress(cc::span<uint8_t const> in)
+{
+    size_t pos = 0;
+    size_t const size = read_varint(in, pos);
+
+    cc::vector<uint8_t> out;
+    out.reserve(size);
+
+    while (true)
+    {
+        size_t const lits = read_varint(in, pos);
+        CC_ASSERT(pos + lits <= in.size() && out.size() + lits <= size && "corrupt trace");
+        for (size_t i = 0; i < lits; ++i)
+            out.push_back(in[pos++]);
+
+        if (out.size() == size)
+            break;
+
+        size_t const len = read_varint(in, pos) + lz_min_match;
+        size_t const dist = read_varint(in, pos);
+        CC_ASSERT(dist > 0 && dist <= out.size() && out.size() + len <= size && "corrupt trace");
+
+        // byte-wise, matches may overlap themselves
+        auto const from = out.size() - dist;
+        for (size_t i = 0; i < len; ++i)
         {
-            s += ':';
-            s += trace_charset[i % ccnt];
-            i /= ccnt;
-            s += trace_charset[i % ccnt];
-            s += trace_charset[i / ccnt];
+            auto const b = out[from + i];
+            out.push_back(b);
+        }
+    }
+
+    return out;
+}
+
+cc::string armor(cc::span<uint8_t const> data)
+{
+    cc::string s;
+    s += armor_prefix;
+
+    uint32_t acc = 0;
+    auto bits = 0;
+    for (auto b : data)
+    {
+        acc = (acc << 8) | b;
+        bits += 8;
+        while (bits >= 6)
+        {
+            bits -= 6;
+            s += armor_charset[(acc >> bits) & 63];
         }
-        else
-            CC_ASSERT(false && "data too big");
     }
+    if (bits > 0)
+        s += armor_charset[(acc << (6 - bits)) & 63];
 
     return s;
 }
 
-cc::vector<int> nx::detail::trace_decode(cc::string_view encoded_string)
+cc::vector<uint8_t> dearmor(cc::string_view s)
+{
+    CC_ASSERT(!s.empty() && s[0] == armor_prefix);
+
+    cc::vector<uint8_t> data;
+    uint32_t acc = 0;
+    auto bits = 0;
+    for (auto i = 1; i < int(s.size()); ++i)
+    {
+        acc = (acc << 6) | uint32_t(armor_table[s[i]]);
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            data.push_back(uint8_t(acc >> bits));
+        }
+    }
+
+    return data;
+}
+
+cc::vector<int> legacy_decode(cc::string_view encoded_string)
 {
     auto pos = 0;
 
-    auto constexpr ccnt = int(trace_charset.size());
+    auto const digit = [&] {
+        CC_ASSERT(pos < int(encoded_string.size()) && "truncated trace");
+        return legacy_table[encoded_string[pos++]];
+    };
 
     auto read_int = [&] {
         auto c = encoded_string[pos++];
         int i;
         if (c == ':')
         {
-            auto c1 = encoded_string[pos++];
-            auto c2 = encoded_string[pos++];
-            auto c3 = encoded_string[pos++];
-            i = (find_char(c3) * ccnt + find_char(c2)) * ccnt + find_char(c1);
+            auto d1 = digit();
+            auto d2 = digit();
+            auto d3 = digit();
+            i = (d3 * legacy_ccnt + d2) * legacy_ccnt + d1;
         }
         else if (c == '.')
         {
-            auto c1 = encoded_string[pos++];
-            auto c2 = encoded_string[pos++];
-            i = find_char(c2) * ccnt + find_char(c1);
+            auto d1 = digit();
+            auto d2 = digit();
+            i = d2 * legacy_ccnt + d1;
         }
         else
-            i = find_char(c);
+            i = legacy_table[c];
         return i - 1;
     };
 
@@ -84,3 +245,90 @@ cc::vector<int> nx::detail::trace_decode(cc::string_view encoded_string)
 
     return v;
 }
+}
+
+cc::vector<uint8_t> nx::detail::trace_encode_binary(cc::span<int const> data)
+{
+    cc::vector<uint8_t> raw;
+    raw.reserve(data.size() + 1);
+    for (auto i : data)
+    {
+        CC_ASSERT(i >= -1);
+        write_varint(raw, uint32_t(i) + 1);
+    }
+
+    auto packed = lz_compress(raw);
+    auto const compress = packed.size() < raw.size();
+
+    cc::vector<uint8_t> out;
+    out.push_back(uint8_t(binary_version << 4 | (compress ? binary_flag_compressed : 0)));
+    for (auto b : compress ? packed : raw)
+        out.push_back(b);
+    return out;
+}
+
+cc::vector<int> nx::detail::trace_decode_binary(cc::span<uint8_t const> data)
+{
+    CC_ASSERT(!data.empty() && "empty trace");
+    auto const header = data[0];
+    CC_ASSERT((header >> 4) == binary_version && "unsupported trace version");
+
+    auto payload = data.subspan(1);
+    cc::vector<uint8_t> unpacked;
+    if (header & binary_flag_compressed)
+    {
+        unpacked = lz_decompress(payload);
+        payload = unpacked;
+    }
+
+    cc::vector<int> v;
+    size_t pos = 0;
+    while (pos < payload.size())
+        v.push_back(int(read_varint(payload, pos) - 1));
+    return v;
+}
+
+cc::string nx::detail::trace_encode(cc::span<const int> data) { return armor(trace_encode_binary(data)); }
+
+cc::vector<int> nx::detail::trace_decode(cc::string_view encoded_string)
+{
+    if (!encoded_string.empty() && encoded_string[0] == armor_prefix)
+        return trace_decode_binary(dearmor(encoded_string));
+
+    return legacy_decode(encoded_string);
+}
+
+bool nx::detail::trace_write_file(cc::string const& filename, cc::span<int const> data)
+{
+    auto const bin = trace_encode_binary(data);
+
+    std::ofstream file(filename.c_str(), std::ios::binary);
+    file.write(file_magic, file_magic_size);
+    file.write(reinterpret_cast<char const*>(bin.data()), std::streamsize(bin.size()));
+    return bool(file);
+}
+
+cc::string nx::detail::trace_read_file(cc::string const& filename)
+{
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    if (!file)
+        return {};
+
+    cc::vector<uint8_t> content;
+    for (auto it = std::istreambuf_iterator<char>(file); it != std::istreambuf_iterator<char>(); ++it)
+        content.push_back(uint8_t(*it));
+
+    auto is_binary = int(content.size()) > file_magic_size;
+    for (auto i = 0; is_binary && i < file_magic_size; ++i)
+        is_binary = content[i] == uint8_t(file_magic[i]);
+
+    if (is_binary)
+        return armor(cc::span<uint8_t const>(content).subspan(file_magic_size));
+
+    // text trace, e.g. copied from a log
+    cc::string s;
+    for (auto c : content)
+        if (c > ' ')
+            s += char(c);
+    return s;
+}
@@ -1,10 +1,27 @@
 #pragma once
 
+#include <cstdint>
+
 #include <clean-core/fwd.hh>
 #include <clean-core/span.hh>
 
 namespace nx::detail
 {
+/// text form of a trace, as used in reproduce("...") and --repr
+/// encodes as '_' followed by the armored binary form (see below)
+/// decoding also accepts the legacy base-63 strings (no leading '_')
 cc::string trace_encode(cc::span<int const> data);
 cc::vector<int> trace_decode(cc::string_view encoded_string);
+
+/// binary form: one header byte, then the values (all >= -1) as LEB128 varints of (v + 1)
+/// the varint stream is LZ-compressed if that makes it smaller
+cc::vector<uint8_t> trace_encode_binary(cc::span<int const> data);
+cc::vector<int> trace_decode_binary(cc::span<uint8_t const> data);
+
+/// trace files (see --save-traces dir and --repr @file)
+/// files contain a small magic followed by the binary form
+/// trace_read_file also accepts files that contain a text trace
+/// returns the text form (for reproduce) or an empty string on error
+bool trace_write_file(cc::string const& filename, cc::span<int const> data);
+cc::string trace_read_file(cc::string const& filename);
 }
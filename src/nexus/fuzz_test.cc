@@ -5,13 +5,550 @@
 #include <chrono>
 
 #include <clean-core/defer.hh>
+#include <clean-core/format.hh>
 #include <clean-core/intrinsics.hh>
+#include <clean-core/span.hh>
+#include <clean-core/string.hh>
+#include <clean-core/string_view.hh>
+#include <clean-core/vector.hh>
+
+#include <typed-geometry/functions/basic/minmax.hh>
 
 #include <nexus/detail/assertions.hh>
 #include <nexus/detail/exception.hh>
 #include <nexus/detail/log.hh>
+#include <nexus/detail/trace_serialize.hh>
 #include <nexus/tests/Test.hh>
 
+#ifndef CC_OS_WINDOWS
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+void run_fuzz_iteration(void (*f)(tg::rng&), size_t seed)
+{
+    tg::rng rng;
+    rng.seed(seed);
+    f(rng);
+}
+
+/// true if executing the seeds in order fails
+bool fuzz_seeds_fail(void (*f)(tg::rng&), cc::span<size_t const> seeds)
+{
+    try
+    {
+        for (auto s : seeds)
+            run_fuzz_iteration(f, s);
+    }
+    catch (nx::detail::assertion_failed_exception const&)
+    {
+        return true;
+    }
+    return false;
+}
+
+/// reproductions of failures that only occur after previous iterations replay a sequence of seeds
+/// they are stored as traces, with each seed split into 16 bit chunks (traces hold small non-negative ints)
+constexpr int seed_chunks = int(sizeof(size_t)) / 2;
+
+cc::string encode_seed_sequence(cc::span<size_t const> seeds)
+{
+    cc::vector<int> data;
+    data.reserve(seeds.size() * seed_chunks);
+    for (auto s : seeds)
+        for (auto i = 0; i < seed_chunks; ++i)
+            data.push_back(int((s >> (16 * i)) & 0xFFFF));
+    return nx::detail::trace_encode(data);
+}
+
+cc::vector<size_t> decode_seed_sequence(cc::string_view trace)
+{
+    auto const data = nx::detail::trace_decode(trace);
+    CC_ASSERT(data.size() % seed_chunks == 0 && "invalid FUZZ_TEST reproduction");
+
+    cc::vector<size_t> seeds;
+    for (size_t i = 0; i < data.size(); i += seed_chunks)
+    {
+        size_t s = 0;
+        for (auto c = 0; c < seed_chunks; ++c)
+            s |= size_t(data[i + c]) << (16 * c);
+        seeds.push_back(s);
+    }
+    return seeds;
+}
+
+/// called after the last seed of a batch failed
+/// returns reproduce(seed) if the failing seed also fails in isolation
+/// otherwise, the failure depends on state leaking from previous iterations:
+/// the shortest failing suffix of the batch is bisected and the reproduction replays all of its seeds
+nx::reproduce find_reproduction(nx::Test* test, void (*f)(tg::rng&), cc::span<size_t const> seeds)
+{
+    using namespace nx::detail;
+
+    CC_ASSERT(!seeds.empty());
+    auto const failing_seed = seeds.back();
+    if (seeds.size() == 1)
+        return nx::reproduce(failing_seed);
+
+    // re-executions should not count as additional checks
+    auto const num_checks = number_of_assertions();
+    auto const num_failed_checks = number_of_failed_assertions();
+    auto const was_silenced = is_silenced();
+    is_silenced() = true;
+    CC_DEFER
+    {
+        number_of_assertions() = num_checks;
+        number_of_failed_assertions() = num_failed_checks;
+        is_silenced() = was_silenced;
+    };
+
+    if (fuzz_seeds_fail(f, seeds.subspan(seeds.size() - 1, 1)))
+        return nx::reproduce(failing_seed);
+
+    // find largest start index that still fails (start 0 is known to fail)
+    auto lo = 0;
+    auto hi = int(seeds.size()) - 1;
+    while (lo + 1 < hi)
+    {
+        auto const mid = (lo + hi) / 2;
+        if (fuzz_seeds_fail(f, seeds.subspan(mid, seeds.size() - mid)))
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    RICH_LOG_WARN("FUZZ_TEST(\"%s\"): seed %s does not fail in isolation, only after the previous %s iteration(s) (state leaks between iterations?)",
+                  test->name(), failing_seed, int(seeds.size()) - 1 - lo);
+    RICH_LOG_WARN("  the reproduction replays all of these iterations in order");
+    return nx::reproduce(encode_seed_sequence(seeds.subspan(lo, seeds.size() - lo)));
+}
+}
+
+namespace
+{
+struct reported_fuzz_cost
+{
+    double cost = 0;
+    bool is_set = false;
+};
+reported_fuzz_cost& current_fuzz_cost()
+{
+    thread_local static reported_fuzz_cost c;
+    return c;
+}
+
+/// an input of perf_fuzz: the draws of the rng seeded with seed, after discarding the first skip draws
+/// tg::rng has no hooks for its individual draws, so mutations shift the draw stream of a kept input instead:
+/// the shifted input consumes the same draws, only starting at a different one
+/// (unlike neighboring seeds, which yield unrelated streams)
+struct perf_fuzz_input
+{
+    size_t seed = 0;
+    int skip = 0;
+};
+
+constexpr int max_perf_fuzz_skip = 1 << 12;
+
+void run_perf_fuzz_input(void (*f)(tg::rng&), perf_fuzz_input const& in)
+{
+    tg::rng rng;
+    rng.seed(in.seed);
+    for (auto i = 0; i < in.skip; ++i)
+        rng();
+    f(rng);
+}
+
+/// unshifted inputs reproduce via their seed, shifted ones via a trace of the seed chunks and the shift
+nx::reproduce perf_fuzz_reproduction(perf_fuzz_input const& in)
+{
+    if (in.skip == 0)
+        return nx::reproduce(in.seed);
+
+    cc::vector<int> data;
+    for (auto i = 0; i < seed_chunks; ++i)
+        data.push_back(int((in.seed >> (16 * i)) & 0xFFFF));
+    data.push_back(in.skip);
+    return nx::reproduce(nx::detail::trace_encode(data));
+}
+
+perf_fuzz_input decode_perf_fuzz_input(nx::reproduce const& r)
+{
+    if (r.trace.empty())
+        return {r.seed, 0};
+
+    auto const data = nx::detail::trace_decode(r.trace);
+    CC_ASSERT(int(data.size()) == seed_chunks + 1 && "invalid perf FUZZ_TEST reproduction");
+
+    perf_fuzz_input in;
+    for (auto c = 0; c < seed_chunks; ++c)
+        in.seed |= size_t(data[c]) << (16 * c);
+    in.skip = data[seed_chunks];
+    return in;
+}
+
+cc::string reproduction_string(nx::reproduce const& r)
+{
+    if (r.trace.empty())
+        return cc::format("reproduce(%s)", r.seed);
+    return cc::format("reproduce(\"%s\")", r.trace);
+}
+
+/// keeps a corpus of the costliest inputs and mutates them to push the cost higher
+/// half of the iterations sample fresh seeds, the other half shift the draw stream of a corpus input (see perf_fuzz_input)
+/// all costs of a run have the same unit: cycles, or the reported cost once any iteration calls nx::fuzz_cost
+/// (iterations without a report then have cost 0)
+void execute_perf_fuzz_test(nx::Test* test, void (*f)(tg::rng&), tg::rng& base_rng)
+{
+    using namespace nx::detail;
+
+    auto const max_cycles = test->fuzzCycles();
+    auto const max_iterations = test->fuzzIterations();
+    auto const corpus_size = 16;
+    auto const reported_inputs = 5;
+    auto const max_shift = 8;
+
+    struct entry
+    {
+        perf_fuzz_input in;
+        double cost;
+    };
+    cc::vector<entry> corpus; // sorted by descending cost
+    auto uses_reported_cost = false;
+
+    auto const measure = [&](perf_fuzz_input const& in) -> double
+    {
+        current_fuzz_cost() = {};
+        auto const c0 = cc::intrin_rdtsc();
+        run_perf_fuzz_input(f, in);
+        auto const c1 = cc::intrin_rdtsc();
+
+        if (current_fuzz_cost().is_set && !uses_reported_cost)
+        {
+            // measured cycles are not comparable to reported costs
+            uses_reported_cost = true;
+            corpus.clear();
+        }
+        if (uses_reported_cost)
+            return current_fuzz_cost().is_set ? current_fuzz_cost().cost : 0.0;
+        return double(c1 - c0);
+    };
+
+    auto const add_to_corpus = [&](perf_fuzz_input const& in, double cost)
+    {
+        if (int(corpus.size()) == corpus_size && cost <= corpus.back().cost)
+            return;
+        for (auto const& e : corpus)
+            if (e.in.seed == in.seed && e.in.skip == in.skip)
+                return;
+
+        if (int(corpus.size()) == corpus_size)
+            corpus.pop_back();
+        corpus.push_back({in, cost});
+        for (auto i = int(corpus.size()) - 1; i > 0 && corpus[i - 1].cost < corpus[i].cost; --i)
+            std::swap(corpus[i - 1], corpus[i]);
+    };
+
+    auto const next_input = [&]() -> perf_fuzz_input
+    {
+        // explore fresh seeds until the corpus is full, then mutate half of the time
+        if (int(corpus.size()) < corpus_size || base_rng() % 2 == 0)
+            return {size_t(base_rng()), 0};
+
+        // prefer costlier parents
+        auto const pi = tg::min(base_rng() % corpus.size(), base_rng() % corpus.size());
+        auto in = corpus[pi].in;
+        auto const shift = 1 + int(base_rng() % max_shift);
+        if (in.skip >= shift && base_rng() % 2 == 0)
+            in.skip -= shift; // restore earlier draws
+        else
+            in.skip = tg::min(in.skip + shift, max_perf_fuzz_skip); // drop leading draws
+        return in;
+    };
+
+    auto const report = [&]
+    {
+        RICH_LOG("perf FUZZ_TEST(\"%s\"): costliest inputs (%s)", test->name(), uses_reported_cost ? "reported cost" : "cycles");
+        for (auto i = 0; i < tg::min(reported_inputs, int(corpus.size())); ++i)
+            RICH_LOG("  cost %<14s  %s", corpus[i].cost, reproduction_string(perf_fuzz_reproduction(corpus[i].in)));
+    };
+
+    if (test->isEndless())
+        RICH_LOG("endless perf FUZZ_TEST(\"%s\")", test->name());
+
+    auto c_start = cc::intrin_rdtsc();
+    auto it = 0;
+    auto t0 = std::chrono::high_resolution_clock::now();
+    while (true)
+    {
+        auto const in = next_input();
+
+        // execute
+        double cost;
+        if (test->isDebug())
+            cost = measure(in);
+        else
+        {
+            try
+            {
+                cost = measure(in);
+            }
+            catch (assertion_failed_exception const&)
+            {
+                test->setReproduce(perf_fuzz_reproduction(in));
+                return;
+            }
+        }
+        add_to_corpus(in, cost);
+        ++it;
+
+        if (test->isEndless())
+        {
+            // progress report
+            auto t1 = std::chrono::high_resolution_clock::now();
+            using namespace std::chrono_literals;
+            if (t1 - t0 > 1000ms && !corpus.empty())
+            {
+                t0 = t1;
+                RICH_LOG("endless perf FUZZ_TEST: %s iterations, max cost %s (%s)", it, corpus.front().cost, reproduction_string(perf_fuzz_reproduction(corpus.front().in)));
+            }
+
+            continue;
+        }
+
+        if (it > max_iterations)
+            break;
+
+        if (cc::intrin_rdtsc() - c_start > max_cycles)
+            break;
+    }
+
+    report();
+}
+}
+
+#ifndef CC_OS_WINDOWS
+namespace
+{
+/// a child that does not advance to its next seed within this time is killed and the seed is reported as a hang
+/// far above the usual iteration times (micro- to milliseconds), while infinite loops are still detected quickly
+constexpr auto fork_server_hang_timeout = std::chrono::milliseconds(1000);
+
+/// state shared between the fork-server parent and its current child
+/// the child reports the seed index it is working on, so crashes and hangs can be attributed exactly
+/// and the location of a failed check, so it can be reported like in-process failures
+struct fork_server_state
+{
+    static constexpr int max_batch_size = 256;
+
+    volatile int current_idx;       // seed that is currently executed by the child
+    volatile int failed_idx;        // seed that failed a check, -1 if none
+    volatile int num_checks;        // accumulated by the child
+    volatile int num_failed_checks; // accumulated by the child
+    int start_idx;
+    int batch_size;
+    size_t seeds[max_batch_size];
+
+    // first failed check of the child (valid if failed_idx >= 0, truncated if too long)
+    int fail_line;
+    char fail_message[1024];
+    char fail_file[512];
+    char fail_function[256];
+};
+
+[[noreturn]] void run_fork_server_child(nx::Test* test, fork_server_state* state, void (*f)(tg::rng&))
+{
+    using namespace nx::detail;
+
+    // the parent may already have failed (only the check failing in this child should be reported)
+    test->clearFirstFailInfo();
+
+    auto const checks_start = number_of_assertions();
+    auto const failed_checks_start = number_of_failed_assertions();
+    auto const report_checks = [&]
+    {
+        state->num_checks = number_of_assertions() - checks_start;
+        state->num_failed_checks = number_of_failed_assertions() - failed_checks_start;
+    };
+
+    for (auto i = state->start_idx; i < state->batch_size; ++i)
+    {
+        state->current_idx = i;
+
+        try
+        {
+            run_fuzz_iteration(f, state->seeds[i]);
+        }
+        catch (assertion_failed_exception const&)
+        {
+            std::snprintf(state->fail_message, sizeof(state->fail_message), "%s", test->firstFailMessage().c_str());
+            std::snprintf(state->fail_file, sizeof(state->fail_file), "%s", test->firstFailFile().c_str());
+            std::snprintf(state->fail_function, sizeof(state->fail_function), "%s", test->firstFailFunction().c_str());
+            state->fail_line = test->firstFailLine();
+            state->failed_idx = i;
+            report_checks();
+            fflush(stdout);
+            fflush(stderr);
+            _exit(1);
+        }
+
+        // cheap enough to do per iteration and keeps counts valid if the next seed crashes
+        report_checks();
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    _exit(0);
+}
+
+/// forks children that execute batches of seeds until the budget is exhausted
+/// returns after the budget or never (endless)
+void execute_fuzz_test_forked(nx::Test* test, void (*f)(tg::rng&))
+{
+    using namespace std::chrono_literals;
+    using namespace nx::detail;
+
+    auto const max_iterations = test->fuzzIterations();
+    auto const max_cycles = test->fuzzCycles();
+
+    auto state = static_cast<fork_server_state*>(mmap(nullptr, sizeof(fork_server_state), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    CC_ASSERT(state != MAP_FAILED && "unable to map shared memory for fork server");
+    CC_DEFER { munmap(state, sizeof(fork_server_state)); };
+
+    tg::rng base_rng;
+    base_rng.seed(test->seed());
+
+    if (test->isEndless())
+        RICH_LOG("endless FUZZ_TEST(\"%s\") (fork server)", test->name());
+
+    // crashes and hangs have no check and are attributed to the test itself
+    auto const report_failure = [&](size_t seed, char const* reason, char const* check, char const* file, int line, char const* function)
+    {
+        RICH_LOG_ERROR("FUZZ_TEST(\"%s\") %s for reproduce(%s)", test->name(), reason, seed);
+
+        // first failure becomes the reproduction, later ones are only logged
+        if (!test->shouldReproduce())
+        {
+            test->setReproduce(nx::reproduce(seed));
+            test->setFirstFailInfo(check, file, line, function);
+        }
+    };
+    auto const report_test_failure = [&](size_t seed, char const* reason) { report_failure(seed, reason, reason, test->file(), test->line(), test->functionName()); };
+
+    auto c_start = cc::intrin_rdtsc();
+    auto it = 0;
+    auto assert_cnt_start = number_of_assertions();
+    auto t0 = std::chrono::high_resolution_clock::now();
+    while (true)
+    {
+        // prepare batch
+        state->batch_size = test->isEndless() ? fork_server_state::max_batch_size : tg::min(fork_server_state::max_batch_size, max_iterations - it + 1);
+        for (auto i = 0; i < state->batch_size; ++i)
+            state->seeds[i] = base_rng();
+        state->start_idx = 0;
+
+        // run children until batch is done (a new child per crash or hang)
+        while (state->start_idx < state->batch_size)
+        {
+            state->current_idx = state->start_idx;
+            state->failed_idx = -1;
+            state->num_checks = 0;
+            state->num_failed_checks = 0;
+
+            // do not duplicate buffered output in the child
+            fflush(stdout);
+            fflush(stderr);
+
+            auto const pid = fork();
+            CC_ASSERT(pid >= 0 && "fork failed");
+            if (pid == 0)
+                run_fork_server_child(test, state, f);
+
+            // wait for child, kill it if it does not make progress
+            int status = 0;
+            auto hang = false;
+            auto last_idx = state->current_idx;
+            auto t_progress = std::chrono::steady_clock::now();
+            while (waitpid(pid, &status, WNOHANG) == 0)
+            {
+                auto const t_now = std::chrono::steady_clock::now();
+                if (state->current_idx != last_idx)
+                {
+                    last_idx = state->current_idx;
+                    t_progress = t_now;
+                }
+                else if (t_now - t_progress > fork_server_hang_timeout)
+                {
+                    kill(pid, SIGKILL);
+                    waitpid(pid, &status, 0);
+                    hang = true;
+                    break;
+                }
+
+                std::this_thread::sleep_for(100us);
+            }
+
+            number_of_assertions() += state->num_checks;
+            number_of_failed_assertions() += state->num_failed_checks;
+
+            auto const idx = state->current_idx;
+            if (hang)
+            {
+                number_of_failed_assertions()++;
+                report_test_failure(state->seeds[idx], "timed out");
+            }
+            else if (WIFSIGNALED(status))
+            {
+                number_of_failed_assertions()++;
+                report_test_failure(state->seeds[idx], cc::format("crashed with signal %s (%s)", WTERMSIG(status), strsignal(WTERMSIG(status))).c_str());
+            }
+            else if (state->failed_idx >= 0 && state->fail_message[0] == '\0')
+                report_test_failure(state->seeds[state->failed_idx], "failed a check");
+            else if (state->failed_idx >= 0)
+                report_failure(state->seeds[state->failed_idx], cc::format("failed check '%s' in %s:%s", state->fail_message, state->fail_file, state->fail_line).c_str(),
+                               state->fail_message, state->fail_file, state->fail_line, state->fail_function);
+            else
+            {
+                CC_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0 && "unexpected exit of fork server child");
+                it += state->batch_size - state->start_idx;
+                break; // batch done
+            }
+
+            // continue after the failing seed with a fresh child
+            it += idx + 1 - state->start_idx;
+            state->start_idx = idx + 1;
+        }
+
+        if (test->isEndless())
+        {
+            // progress report
+            auto t1 = std::chrono::high_resolution_clock::now();
+            if (t1 - t0 > 1000ms)
+            {
+                t0 = t1;
+                RICH_LOG("endless FUZZ_TEST: %s assertions", number_of_assertions() - assert_cnt_start);
+            }
+
+            continue;
+        }
+
+        if (it > max_iterations)
+            break;
+
+        if (cc::intrin_rdtsc() - c_start > max_cycles)
+            break;
+    }
+}
+}
+#endif
+
 
 void nx::detail::execute_fuzz_test(void (*f)(tg::rng&))
 {
@@ -20,14 +557,27 @@ void nx::detail::execute_fuzz_test(void (*f)(tg::rng&))
     // reproduction
     if (test->shouldReproduce())
     {
-        tg::rng rng;
-        rng.seed(test->reproduction().seed);
-        f(rng);
+        // perf_fuzz inputs can have shifted draw streams (see perf_fuzz_input)
+        if (test->isPerfFuzz())
+        {
+            run_perf_fuzz_input(f, decode_perf_fuzz_input(test->reproduction()));
+            return;
+        }
+
+        // a seed sequence for failures that depend on previous iterations (see find_reproduction)
+        if (!test->reproduction().trace.empty())
+        {
+            for (auto s : decode_seed_sequence(test->reproduction().trace))
+                run_fuzz_iteration(f, s);
+            return;
+        }
+
+        run_fuzz_iteration(f, test->reproduction().seed);
         return;
     }
 
-    auto const max_cycles = 10'000'000; // TODO: configurable
-    auto const max_iterations = 1000;   // TODO: configurable
+    auto const max_iterations = test->fuzzIterations();
+    auto const max_cycles = test->fuzzCycles();
 
     tg::rng base_rng;
     base_rng.seed(test->seed());
@@ -41,35 +591,69 @@ void nx::detail::execute_fuzz_test(void (*f)(tg::rng&))
         nx::detail::reset_assertion_handlers();
     };
 
+    if (test->isPerfFuzz())
+    {
+        execute_perf_fuzz_test(test, f, base_rng);
+        return;
+    }
+
+#ifndef CC_OS_WINDOWS
+    if (test->isForkServer() && !test->isDebug())
+    {
+        execute_fuzz_test_forked(test, f);
+        return;
+    }
+#else
+    if (test->isForkServer())
+        RICH_LOG_WARN("fork_server is not supported on this platform, executing FUZZ_TEST(\"%s\") in-process", test->name());
+#endif
+
     if (test->isEndless())
         RICH_LOG("endless FUZZ_TEST(\"%s\")", test->name());
 
+    // iterations are dispatched in batches, so the try/catch and the budget checks are amortized for cheap bodies
+    // each iteration still gets its own seed, i.e. reproductions stay per-seed
+    auto constexpr max_batch_size = 1024;
+    size_t seeds[max_batch_size];
+    auto batch_size = 1;
+
     auto c_start = cc::intrin_rdtsc();
     auto it = 0;
     auto assert_cnt_start = nx::detail::number_of_assertions();
     auto t0 = std::chrono::high_resolution_clock::now();
     while (true)
     {
-        auto seed = base_rng();
-        tg::rng rng;
-        rng.seed(seed);
+        if (!test->isEndless())
+            batch_size = tg::min(batch_size, max_iterations - it + 1);
+        for (auto i = 0; i < batch_size; ++i)
+            seeds[i] = base_rng();
 
         // execute
+        auto const c_batch_start = cc::intrin_rdtsc();
+        auto i = 0;
         if (test->isDebug())
-            f(rng);
+        {
+            for (; i < batch_size; ++i)
+                run_fuzz_iteration(f, seeds[i]);
+        }
         else
         {
             try
             {
-                f(rng);
+                for (; i < batch_size; ++i)
+                    run_fuzz_iteration(f, seeds[i]);
             }
             catch (assertion_failed_exception const&)
             {
-                test->setReproduce(reproduce(seed));
+                test->setReproduce(find_reproduction(test, f, cc::span<size_t const>(seeds, i + 1)));
                 return;
             }
         }
-        ++it;
+        it += batch_size;
+
+        // grow batches while they are cheap compared to the budget
+        if (batch_size < max_batch_size && cc::intrin_rdtsc() - c_batch_start < max_cycles / 100)
+            batch_size *= 2;
 
         if (test->isEndless())
         {
@@ -92,3 +676,10 @@ void nx::detail::execute_fuzz_test(void (*f)(tg::rng&))
             break;
     }
 }
+
+void nx::fuzz_cost(double cost)
+{
+    auto& c = current_fuzz_cost();
+    c.cost += cost;
+    c.is_set = true;
+}
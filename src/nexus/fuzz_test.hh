@@ -29,6 +29,15 @@
     NX_TEST(__VA_ARGS__) { ::nx::detail::execute_fuzz_test(fuzz_fun); } \
     void fuzz_fun
 
+namespace nx
+{
+/// reports the cost of the current fuzz iteration (e.g. number of allocations or comparisons)
+/// used by perf_fuzz instead of the measured cycles, multiple calls are accumulated
+/// (if any iteration reports a cost, all iterations are ranked by their reported cost)
+/// NOTE: only valid inside a fuzz test
+NX_API void fuzz_cost(double cost);
+}
+
 namespace nx::detail
 {
 NX_API void execute_fuzz_test(void (*f)(tg::rng&));
@@ -1,9 +1,45 @@
 #pragma once
 
+#include <cstdint>
+
+#include <clean-core/assert.hh>
+#include <clean-core/set.hh>
+#include <clean-core/vector.hh>
+
 #include <nexus/minimize_options.hh>
+#include <nexus/shrink.hh>
 
 namespace nx
 {
+namespace detail
+{
+/// remembers the hashes of inputs that were already found to pass
+/// so that no candidate is evaluated twice (only for types with a minimize_hash)
+/// NOTE: a hash collision can skip a candidate, which only makes the result less minimal
+template <class T>
+struct minimize_memo
+{
+    cc::set<uint64_t> passing;
+
+    template <class IsFailingF>
+    bool is_failing(T const& v, IsFailingF& f)
+    {
+        if constexpr (is_minimize_hashable<T>::value)
+        {
+            auto const h = minimize_hash(v);
+            if (passing.contains(h))
+                return false;
+            if (f(v))
+                return true;
+            passing.add(h);
+            return false;
+        }
+        else
+            return f(v);
+    }
+};
+}
+
 /// generic minimization of a test case
 /// takes an input test case (any type)
 ///       an option generator (function from T -> minimize_options<T>)
@@ -16,25 +52,53 @@ namespace nx
 ///
 /// NOTE: the functions can also accept T const&
 ///       this arg is guaranteed to surpass the lifetime of the returning minimize_options<T>
+///
+/// NOTE: generator options (see minimize_options::from_generator) need a copyable T (candidates are built into a reused copy of the input)
+///       lists of options also work for move-only T
+///       is_failing results are memoized for hashable T (arithmetic types, cc::string, cc::vector of those)
 template <class T, class OptionGeneratorF, class IsFailingF>
 T minimize(T input, OptionGeneratorF&& generate_options, IsFailingF&& is_failing)
 {
     static_assert(std::is_invocable_r_v<minimize_options<T>, OptionGeneratorF, T>);
     static_assert(std::is_invocable_r_v<bool, IsFailingF, T>);
 
+    detail::minimize_memo<T> memo;
+
     while (true)
     {
         minimize_options<T> opts = generate_options(input);
 
         auto has_smaller = false;
-        while (opts.has_options_left())
+        auto const try_candidate = [&](T& smaller_input)
+        {
+            if (!memo.is_failing(smaller_input, is_failing))
+                return false;
+
+            input = cc::move(smaller_input);
+            has_smaller = true;
+            return true;
+        };
+
+        if (opts.generator)
+        {
+            if constexpr (std::is_copy_constructible_v<T>)
+            {
+                // candidates are pulled one by one into the same buffer
+                T smaller_input = input;
+                while (opts.next_option_for(input, smaller_input))
+                    if (try_candidate(smaller_input))
+                        break;
+            }
+            else
+                CC_UNREACHABLE("generator options need a copyable T");
+        }
+        else
         {
-            T smaller_input = opts.get_next_option_for(input);
-            if (is_failing(smaller_input))
+            while (opts.has_options_left())
             {
-                input = cc::move(smaller_input);
-                has_smaller = true;
-                break;
+                T smaller_input = opts.get_next_option_for(input);
+                if (try_candidate(smaller_input))
+                    break;
             }
         }
 
@@ -44,4 +108,75 @@ T minimize(T input, OptionGeneratorF&& generate_options, IsFailingF&& is_failing
 
     return input;
 }
+
+/// same as above but with the built-in shrinkers (see nx::shrink)
+/// e.g. auto small = nx::minimize(cc::vector<int>{...}, [](cc::vector<int> const& v) { return !is_sorted(sort(v)); });
+template <class T, class IsFailingF>
+T minimize(T input, IsFailingF&& is_failing)
+{
+    static_assert(detail::has_shrink<T>::value, "no built-in shrinker for this type, provide an option generator");
+    return nx::minimize(cc::move(input), [](T const& v) { return shrink(v); }, is_failing);
+}
+
+/// delta debugging (ddmin) for sequences
+/// returns a 1-minimal failing subsequence of the input (no single element can be removed)
+/// by testing chunks and their complements at doubling granularity
+/// much faster than nx::minimize for large inputs where only a few elements matter
+template <class T, class IsFailingF>
+cc::vector<T> ddmin(cc::vector<T> input, IsFailingF&& is_failing)
+{
+    static_assert(std::is_invocable_r_v<bool, IsFailingF, cc::vector<T>>);
+
+    detail::minimize_memo<cc::vector<T>> memo;
+    cc::vector<T> candidate;
+
+    auto n = 2; // granularity
+    while (input.size() >= 2)
+    {
+        auto const size = int(input.size());
+        auto const chunk = (size + n - 1) / n;
+        auto reduced = false;
+
+        // chunk [start, end) alone
+        for (auto start = 0; start < size && !reduced; start += chunk)
+        {
+            candidate.clear();
+            for (auto i = start; i < start + chunk && i < size; ++i)
+                candidate.push_back(input[i]);
+
+            if (memo.is_failing(candidate, is_failing))
+            {
+                input = cc::move(candidate);
+                n = 2;
+                reduced = true;
+            }
+        }
+
+        // everything except chunk [start, end)
+        for (auto start = 0; start < size && !reduced && n > 2; start += chunk)
+        {
+            candidate.clear();
+            for (auto i = 0; i < size; ++i)
+                if (i < start || i >= start + chunk)
+                    candidate.push_back(input[i]);
+
+            if (memo.is_failing(candidate, is_failing))
+            {
+                input = cc::move(candidate);
+                n = n - 1 > 2 ? n - 1 : 2;
+                reduced = true;
+            }
+        }
+
+        if (!reduced)
+        {
+            if (n >= size)
+                break; // 1-minimal
+
+            n = 2 * n < size ? 2 * n : size;
+        }
+    }
+
+    return input;
+}
 }
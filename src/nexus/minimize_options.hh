@@ -6,17 +6,52 @@
 namespace nx
 {
 /// Sequence of lazy minimization steps
+///
+/// either a list of options (each maps the input to a smaller candidate)
+/// or a generator that enumerates candidates on demand (see from_generator)
 template <class T>
 struct minimize_options
 {
     cc::vector<cc::unique_function<T(T const&)>> options;
     int position = 0;
 
-    bool has_options_left() const { return position < int(options.size()); }
+    /// writes the next candidate for the input into 'out' and returns true
+    /// or returns false once all candidates are enumerated
+    /// NOTE: keeps its own cursor and is always called with the same input
+    cc::unique_function<bool(T const&, T&)> generator;
+
+    /// pull-based alternative to listing options
+    /// only the candidates that are actually tried are ever built
+    static minimize_options from_generator(cc::unique_function<bool(T const&, T&)> gen)
+    {
+        minimize_options m;
+        m.generator = cc::move(gen);
+        return m;
+    }
+
+    bool has_options_left() const
+    {
+        CC_CONTRACT(!generator && "generators can only be pulled via next_option_for");
+        return position < int(options.size());
+    }
     T get_next_option_for(T const& v)
     {
         CC_CONTRACT(has_options_left());
         return options[position++](v);
     }
+
+    /// builds the next candidate into 'out' (works for both forms)
+    /// returns false if there are no options left
+    bool next_option_for(T const& v, T& out)
+    {
+        if (generator)
+            return generator(v, out);
+
+        if (!has_options_left())
+            return false;
+
+        out = get_next_option_for(v);
+        return true;
+    }
 };
 }
@@ -8,6 +8,7 @@
 #ifndef NX_FORCE_MACRO_PREFIX
 
 #define MONTE_CARLO_TEST(...) NX_MONTE_CARLO_TEST(__VA_ARGS__)
+#define MONTE_CARLO_BENCHMARK(...) NX_MONTE_CARLO_BENCHMARK(__VA_ARGS__)
 
 #endif
 
@@ -27,6 +28,18 @@
  */
 #define NX_MONTE_CARLO_TEST(...) NX_DETAIL_REGISTER_MONTE_CARLO_TEST(CC_MACRO_JOIN(_nx_monte_carlo_test_, __COUNTER__), __VA_ARGS__)
 
+/**
+ * Defines a monte carlo test that benchmarks its workload (see nx::mct_benchmark)
+ *
+ * Usage:
+ *   MONTE_CARLO_BENCHMARK("some benchmark", mct_ops(100000))
+ *   {
+ *      addOp("gen", ...);
+ *      ...
+ *   }
+ */
+#define NX_MONTE_CARLO_BENCHMARK(...) NX_MONTE_CARLO_TEST(__VA_ARGS__, ::nx::mct_benchmark)
+
 #define NX_DETAIL_REGISTER_MONTE_CARLO_TEST(mct_class, ...) \
     namespace                                               \
     {                                                       \
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include <clean-core/string.hh>
+#include <clean-core/vector.hh>
+
+#include <nexus/minimize_options.hh>
+
+namespace nx
+{
+/// built-in option generators for nx::minimize (all candidates are enumerated lazily)
+///
+/// - integers: towards zero (0, v/2, 3v/4, ..., v -+ 1), then -v for negative v
+/// - floats: 0, -v, trunc(v), v/2
+/// - cc::vector<T>: removes chunks of halving size (n/2, n/4, ..., 1), then shrinks single elements
+/// - cc::string: removes chunks of halving size, then replaces single chars by 'a'
+///
+/// nx::minimize(input, is_failing) picks these automatically
+
+template <class T>
+minimize_options<cc::vector<T>> shrink(cc::vector<T> const& v);
+minimize_options<cc::string> shrink(cc::string const& s);
+
+inline minimize_options<bool> shrink(bool v)
+{
+    return minimize_options<bool>::from_generator(
+        [v, done = false](bool const&, bool& out) mutable
+        {
+            if (done || !v)
+                return false;
+            done = true;
+            out = false;
+            return true;
+        });
+}
+
+template <class T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+minimize_options<T> shrink(T v)
+{
+    // v - d for d = v, v/2, v/4, ..., i.e. zero first and then closer and closer to v
+    return minimize_options<T>::from_generator(
+        [v, d = v, negated = false](T const&, T& out) mutable
+        {
+            if (d != 0)
+            {
+                out = T(v - d);
+                d /= 2;
+                return true;
+            }
+
+            if constexpr (std::is_signed_v<T>)
+                if (!negated && v < 0 && v != std::numeric_limits<T>::min())
+                {
+                    negated = true;
+                    out = T(-v);
+                    return true;
+                }
+
+            return false;
+        });
+}
+
+template <class T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+minimize_options<T> shrink(T v)
+{
+    return minimize_options<T>::from_generator(
+        [v, step = 0](T const&, T& out) mutable
+        {
+            while (true)
+            {
+                switch (step++)
+                {
+                case 0:
+                    if (v != T(0)) // also true for NaN
+                    {
+                        out = T(0);
+                        return true;
+                    }
+                    break;
+                case 1:
+                    if (v < T(0))
+                    {
+                        out = -v;
+                        return true;
+                    }
+                    break;
+                case 2:
+                    if (std::isfinite(v) && std::trunc(v) != v && std::trunc(v) != T(0))
+                    {
+                        out = std::trunc(v);
+                        return true;
+                    }
+                    break;
+                case 3:
+                    if (std::isfinite(v) && v / 2 != v && v / 2 != T(0))
+                    {
+                        out = v / 2;
+                        return true;
+                    }
+                    break;
+                default:
+                    return false;
+                }
+            }
+        });
+}
+
+namespace detail
+{
+template <class T, class = void>
+struct has_shrink : std::false_type
+{
+};
+template <class T>
+struct has_shrink<T, std::void_t<decltype(shrink(std::declval<T const&>()))>> : std::true_type
+{
+};
+
+/// removes [pos, pos + chunk) for chunk = n/2, n/4, ..., 1
+/// returns false once all chunks were tried
+template <class SeqT>
+struct chunk_remover
+{
+    int chunk = -1;
+    int pos = 0;
+
+    bool next(SeqT const& v, SeqT& out)
+    {
+        auto const n = int(v.size());
+        if (chunk < 0)
+            chunk = n > 1 ? n / 2 : n;
+
+        while (chunk > 0)
+        {
+            if (pos < n)
+            {
+                out.clear();
+                for (auto i = 0; i < n; ++i)
+                    if (i < pos || i >= pos + chunk)
+                        out.push_back(v[i]);
+                pos += chunk;
+                return true;
+            }
+
+            chunk /= 2;
+            pos = 0;
+        }
+
+        return false;
+    }
+};
+}
+
+template <class T>
+minimize_options<cc::vector<T>> shrink(cc::vector<T> const&)
+{
+    struct generator
+    {
+        detail::chunk_remover<cc::vector<T>> chunks;
+        int elem = 0;
+        minimize_options<T> elem_opts;
+        bool has_elem_opts = false;
+
+        bool operator()(cc::vector<T> const& v, cc::vector<T>& out)
+        {
+            if (chunks.next(v, out))
+                return true;
+
+            if constexpr (detail::has_shrink<T>::value)
+            {
+                while (elem < int(v.size()))
+                {
+                    if (!has_elem_opts)
+                    {
+                        elem_opts = shrink(v[elem]);
+                        has_elem_opts = true;
+                    }
+
+                    out = v;
+                    if (elem_opts.next_option_for(v[elem], out[elem]))
+                        return true;
+
+                    ++elem;
+                    has_elem_opts = false;
+                }
+            }
+
+            return false;
+        }
+    };
+
+    return minimize_options<cc::vector<T>>::from_generator(generator{});
+}
+
+inline minimize_options<cc::string> shrink(cc::string const&)
+{
+    struct generator
+    {
+        detail::chunk_remover<cc::string> chunks;
+        int pos = 0;
+
+        bool operator()(cc::string const& s, cc::string& out)
+        {
+            if (chunks.next(s, out))
+                return true;
+
+            while (pos < int(s.size()) && s[pos] == 'a')
+                ++pos;
+            if (pos >= int(s.size()))
+                return false;
+
+            out = s;
+            out[pos++] = 'a';
+            return true;
+        }
+    };
+
+    return minimize_options<cc::string>::from_generator(generator{});
+}
+
+namespace detail
+{
+/// hash used to memoize is_failing results during minimization
+/// (only for types where it is defined, see is_minimize_hashable)
+inline uint64_t minimize_hash_mix(uint64_t h, uint64_t v)
+{
+    h ^= v + 0x9E3779B97F4A7C15uLL + (h << 6) + (h >> 2);
+    return h;
+}
+
+template <class T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+uint64_t minimize_hash(T const& v)
+{
+    uint64_t h = 0;
+    std::memcpy(&h, &v, sizeof(T) < sizeof(h) ? sizeof(T) : sizeof(h));
+    return minimize_hash_mix(0, h);
+}
+
+inline uint64_t minimize_hash(cc::string const& s)
+{
+    auto h = minimize_hash_mix(0, s.size());
+    for (auto c : s)
+        h = minimize_hash_mix(h, uint64_t(uint8_t(c)));
+    return h;
+}
+
+template <class T>
+auto minimize_hash(cc::vector<T> const& v) -> decltype(minimize_hash(std::declval<T const&>()))
+{
+    auto h = minimize_hash_mix(0, v.size());
+    for (auto const& e : v)
+        h = minimize_hash_mix(h, minimize_hash(e));
+    return h;
+}
+
+template <class T, class = void>
+struct is_minimize_hashable : std::false_type
+{
+};
+template <class T>
+struct is_minimize_hashable<T, std::void_t<decltype(minimize_hash(std::declval<T const&>()))>> : std::true_type
+{
+};
+}
+}
@@ -65,6 +65,28 @@ void detail::configure(Test* t, const debug_t&) { t->setDebug(); }
 
 void detail::configure(Test* t, const verbose_t&) { t->setVerbose(); }
 
+void detail::configure(Test* t, const fork_server_t&) { t->setForkServer(); }
+
+void detail::configure(Test* t, const perf_fuzz_t&) { t->setPerfFuzz(); }
+
+void detail::configure(Test* t, const fuzz_budget& b) { t->setFuzzBudget(b.iterations, b.cycles); }
+
+void detail::configure(Test* t, const exhaustive& e) { t->setExhaustive(e.depth, e.rng_choices); }
+
+void detail::configure(Test* t, const mct_threads& n) { t->setMctThreads(n.n); }
+
+void detail::configure(Test* t, const mct_profile_t&) { t->setMctProfile(); }
+
+void detail::configure(Test* t, const mct_benchmark_t&) { t->setMctBenchmark(); }
+
+void detail::configure(Test* t, const mct_swarm_t&) { t->setMctSwarm(); }
+
+void detail::configure(Test* t, const mct_speedup& s) { t->setMctSpeedup(s.max_slowdown); }
+
+void detail::configure(Test* t, const mct_ops& n) { t->setMctOps(n.n); }
+
+void detail::configure(Test* t, const mct_time& ms) { t->setMctTime(ms.ms); }
+
 void detail::configure(Test* t, const opt_in_group& g) { t->addOptInGroup(g.name); }
 
 void nx::print_current_test_reproduction()
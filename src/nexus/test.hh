@@ -100,6 +100,17 @@ NX_API void configure(Test* t, reproduce const& r);
 NX_API void configure(Test* t, disabled_t const&);
 NX_API void configure(Test* t, debug_t const&);
 NX_API void configure(Test* t, verbose_t const&);
+NX_API void configure(Test* t, fork_server_t const&);
+NX_API void configure(Test* t, perf_fuzz_t const&);
+NX_API void configure(Test* t, fuzz_budget const& b);
+NX_API void configure(Test* t, exhaustive const& e);
+NX_API void configure(Test* t, mct_threads const& n);
+NX_API void configure(Test* t, mct_profile_t const&);
+NX_API void configure(Test* t, mct_benchmark_t const&);
+NX_API void configure(Test* t, mct_swarm_t const&);
+NX_API void configure(Test* t, mct_speedup const& s);
+NX_API void configure(Test* t, mct_ops const& n);
+NX_API void configure(Test* t, mct_time const& ms);
 NX_API void configure(Test* t, opt_in_group const& g);
 
 
@@ -8,10 +8,13 @@
 #include <clean-core/assertf.hh>
 #include <clean-core/defer.hh>
 #include <clean-core/demangle.hh>
+#include <clean-core/format.hh>
 #include <clean-core/map.hh>
 #include <clean-core/pair.hh>
 #include <clean-core/set.hh>
 #include <clean-core/span.hh>
+#include <clean-core/string_view.hh>
+#include <clean-core/unique_ptr.hh>
 #include <clean-core/vector.hh>
 
 #include <typed-geometry/feature/random.hh>
@@ -21,16 +24,28 @@
 #include <nexus/detail/assertions.hh>
 #include <nexus/detail/exception.hh>
 #include <nexus/detail/log.hh>
+#include <nexus/detail/parallel.hh>
 #include <nexus/detail/trace_serialize.hh>
 #include <nexus/minimize_options.hh>
 #include <nexus/test.hh>
 #include <nexus/tests/Test.hh>
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
 #include <cstdio>
+#include <exception>
+#include <mutex>
 #include <typeindex>
 
 namespace
 {
+// serialized traces start with the equivalence index (or -1)
+// swarm traces start with swarm_trace_header + equivalence index + 1, followed by the number of disabled ops and their indices
+constexpr int swarm_trace_header = 1 << 20;
+
 bool has_rng_arg(cc::span<std::type_index const> types)
 {
     for (auto ti : types)
@@ -38,8 +53,260 @@ bool has_rng_arg(cc::span<std::type_index const> types)
             return true;
     return false;
 }
+
+/// dir/<test name>.nxtrace with everything but alphanumerics and '-' replaced by '_'
+cc::string trace_file_name(cc::string const& dir, char const* test_name)
+{
+    cc::string filename = dir;
+    filename += '/';
+    for (auto c : cc::string_view(test_name))
+        filename += (isalnum(uint8_t(c)) || c == '-') ? c : '_';
+    filename += ".nxtrace";
+    return filename;
+}
 }
 
+/// opt-in statistics of sampled sessions (see nx::mct_profile)
+/// indexed by function::idx and dense type id, every machine_cache (i.e. thread) collects its own
+struct nx::MonteCarloTest::profile_stats
+{
+    static constexpr int ops_per_bucket = 16; // pool sizes are averaged per bucket of ops since session start
+    static constexpr int max_buckets = 64;    // later ops all go to the last bucket
+
+    struct function_stats
+    {
+        long long executions = 0;
+        double total_ms = 0;
+        double max_ms = 0;
+        long long precondition_checks = 0;
+        long long precondition_rejections = 0;
+        long long fallbacks = 0; // other ops executed because no sampled args satisfied the precondition
+    };
+
+    struct type_stats
+    {
+        int max_size = 0;
+        cc::vector<double> size_sum; // per bucket
+        cc::vector<long long> size_cnt;
+    };
+
+    cc::vector<function_stats> functions;
+    cc::vector<type_stats> types;
+    long long sessions = 0;
+
+    bool is_active() const { return !functions.empty(); }
+
+    void init(MonteCarloTest const& test)
+    {
+        if (is_active())
+            return;
+
+        functions.resize(test.mFunctions.size());
+        types.resize(test.mTypes.size());
+    }
+
+    void record_execution(function const* f, double ms)
+    {
+        auto& fs = functions[f->idx];
+        fs.executions++;
+        fs.total_ms += ms;
+        fs.max_ms = tg::max(fs.max_ms, ms);
+    }
+
+    void record_pool_size(int type, int size, int bucket)
+    {
+        auto& ts = types[type];
+        ts.max_size = tg::max(ts.max_size, size);
+        ensure_bucket(ts, bucket);
+        ts.size_sum[bucket] += size;
+        ts.size_cnt[bucket]++;
+    }
+
+    static void ensure_bucket(type_stats& ts, int bucket)
+    {
+        while (int(ts.size_sum.size()) <= bucket)
+        {
+            ts.size_sum.push_back(0);
+            ts.size_cnt.push_back(0);
+        }
+    }
+
+    void merge(profile_stats const& rhs)
+    {
+        if (!rhs.is_active())
+            return;
+
+        if (!is_active())
+        {
+            *this = rhs;
+            return;
+        }
+
+        sessions += rhs.sessions;
+        for (auto i = 0; i < int(functions.size()); ++i)
+        {
+            auto& l = functions[i];
+            auto const& r = rhs.functions[i];
+            l.executions += r.executions;
+            l.total_ms += r.total_ms;
+            l.max_ms = tg::max(l.max_ms, r.max_ms);
+            l.precondition_checks += r.precondition_checks;
+            l.precondition_rejections += r.precondition_rejections;
+            l.fallbacks += r.fallbacks;
+        }
+        for (auto t = 0; t < int(types.size()); ++t)
+        {
+            auto& l = types[t];
+            auto const& r = rhs.types[t];
+            l.max_size = tg::max(l.max_size, r.max_size);
+            for (auto b = 0; b < int(r.size_sum.size()); ++b)
+            {
+                ensure_bucket(l, b);
+                l.size_sum[b] += r.size_sum[b];
+                l.size_cnt[b] += r.size_cnt[b];
+            }
+        }
+    }
+};
+
+using profile_clock = std::chrono::high_resolution_clock;
+
+static double elapsed_ms(profile_clock::time_point t0) { return std::chrono::duration<double, std::milli>(profile_clock::now() - t0).count(); }
+
+/// paired op timings of the reference and the implementations of an equivalence (see nx::mct_speedup)
+/// every sampled op yields one pair (reference ms, implementation ms) of timings on the same inputs
+/// - per op, the speedup is the geometric mean of the paired ratios (robust against single slow outliers)
+/// - in total, the speedup is the ratio of the total times (i.e. weighted by how expensive the ops are)
+/// every machine_cache (i.e. thread) collects its own
+struct nx::MonteCarloTest::speedup_stats
+{
+    static constexpr double min_ms = 1e-6; // timer resolution, avoids infinite ratios
+
+    struct paired_times
+    {
+        long long n = 0;
+        double sum_a = 0;
+        double sum_b = 0;
+        double sum_aa = 0;
+        double sum_bb = 0;
+        double sum_ab = 0;
+        double sum_log = 0; // of a / b
+        double sum_log2 = 0;
+
+        void add(double a, double b)
+        {
+            a = tg::max(a, min_ms);
+            b = tg::max(b, min_ms);
+            auto const l = std::log(a / b);
+
+            n++;
+            sum_a += a;
+            sum_b += b;
+            sum_aa += a * a;
+            sum_bb += b * b;
+            sum_ab += a * b;
+            sum_log += l;
+            sum_log2 += l * l;
+        }
+
+        void merge(paired_times const& r)
+        {
+            n += r.n;
+            sum_a += r.sum_a;
+            sum_b += r.sum_b;
+            sum_aa += r.sum_aa;
+            sum_bb += r.sum_bb;
+            sum_ab += r.sum_ab;
+            sum_log += r.sum_log;
+            sum_log2 += r.sum_log2;
+        }
+
+        /// geometric mean of the paired speedups and its 95% confidence interval
+        void geomean_speedup(double& speedup, double& lo, double& hi) const
+        {
+            auto const mean = n > 0 ? sum_log / n : 0.0;
+            auto const var = n > 1 ? tg::max(0.0, (sum_log2 - n * mean * mean) / (n - 1)) : 0.0;
+            auto const half = n > 1 ? 1.96 * std::sqrt(var / n) : 0.0;
+            speedup = std::exp(mean);
+            lo = std::exp(mean - half);
+            hi = std::exp(mean + half);
+        }
+
+        /// ratio of the total times and its 95% confidence interval
+        /// (delta method for a ratio of means, the covariance accounts for both sides running on the same inputs)
+        void total_speedup(double& speedup, double& lo, double& hi) const
+        {
+            speedup = sum_b > 0 ? sum_a / sum_b : 1.0;
+            lo = hi = speedup;
+            if (n < 2 || sum_b <= 0)
+                return;
+
+            auto const mean_a = sum_a / n;
+            auto const mean_b = sum_b / n;
+            auto const var_a = (sum_aa - n * mean_a * mean_a) / (n - 1);
+            auto const var_b = (sum_bb - n * mean_b * mean_b) / (n - 1);
+            auto const cov = (sum_ab - n * mean_a * mean_b) / (n - 1);
+            auto const var_r = (var_a - 2 * speedup * cov + speedup * speedup * var_b) / (n * mean_b * mean_b);
+            auto const half = 1.96 * std::sqrt(tg::max(0.0, var_r));
+            lo = tg::max(0.0, speedup - half);
+            hi = speedup + half;
+        }
+    };
+
+    struct implementation_stats
+    {
+        cc::vector<paired_times> ops; // per function::idx of the reference op
+        paired_times total;
+    };
+
+    cc::vector<cc::vector<implementation_stats>> equivalences; // [equivalence][implementation]
+
+    bool is_active() const { return !equivalences.empty(); }
+
+    void init(MonteCarloTest const& test)
+    {
+        if (is_active())
+            return;
+
+        equivalences.resize(test.mEquivalences.size());
+        for (auto i = 0; i < int(equivalences.size()); ++i)
+        {
+            equivalences[i].resize(test.mEquivalences[i].impls.size());
+            for (auto& is : equivalences[i])
+                is.ops.resize(test.mFunctions.size());
+        }
+    }
+
+    void record(int equivalence, int impl, function const* f_a, double ms_a, double ms_b)
+    {
+        auto& is = equivalences[equivalence][impl];
+        is.ops[f_a->idx].add(ms_a, ms_b);
+        is.total.add(ms_a, ms_b);
+    }
+
+    void merge(speedup_stats const& rhs)
+    {
+        if (!rhs.is_active())
+            return;
+
+        if (!is_active())
+        {
+            *this = rhs;
+            return;
+        }
+
+        for (auto e = 0; e < int(equivalences.size()); ++e)
+            for (auto k = 0; k < int(equivalences[e].size()); ++k)
+            {
+                auto& l = equivalences[e][k];
+                auto const& r = rhs.equivalences[e][k];
+                for (auto i = 0; i < int(l.ops.size()); ++i)
+                    l.ops[i].merge(r.ops[i]);
+                l.total.merge(r.total);
+            }
+    }
+};
+
 struct nx::MonteCarloTest::machine
 {
     struct value_set
@@ -48,27 +315,76 @@ struct nx::MonteCarloTest::machine
         cc::vector<function*> safe_generators;        // generators with no input arg of the same type
         cc::vector<function*> mutators_or_generators; // functions generating or mutating this type
         cc::vector<function*> invariants;             // invariants with at least one arg of this type
+        bool has_consumers = false;                   // some op takes this type as T&&, i.e. vars can have empty slots
 
         bool can_safely_generate() const { return safe_generators.size() > 0; }
-        bool has_values() const { return vars.size() > 0; }
+        bool has_values() const
+        {
+            if (!has_consumers)
+                return vars.size() > 0;
+
+            for (auto const& v : vars)
+                if (!v.is_void())
+                    return true;
+            return false;
+        }
     };
 
-    cc::map<std::type_index, value_set> values;
+    value_arena arena;            // NOTE: must outlive all values
+    cc::vector<value_set> values; // indexed by dense type id
     cc::vector<function*> test_functions;
     cc::vector<function*> all_functions;
+    cc::vector<int> local_indices; // function::idx -> index in this machine (-1 if not part of it)
+    cc::vector<int> executions;    // per local index
     MonteCarloTest const* test;
-
+    profile_stats* profile = nullptr; // only set while sampling with nx::mct_profile
+    int profile_ops = 0;              // ops since session start (for the pool size buckets)
+    bool time_ops = false;            // per session, measures last_op_ms (see nx::mct_speedup)
+    double last_op_ms = 0;            // time of the op itself in the last execute (without invariants)
+
+    // sampling (see function::weight and nx::mct_ops)
+    bool has_weights = false;       // any test function with a non-default weight
+    bool weighted_sampling = false; // per session, uniform sampling otherwise
+    bool track_costs = false;       // per session, measures op costs for cost-aware sampling
+    cc::vector<double> cost_ms;     // per local index, accumulated over all sessions of this machine
+    cc::vector<int> cost_calls;     // per local index
+
+    // state coverage (see MonteCarloTest::setHasher)
+    cc::vector<cc::set<uint64_t>>* visited_states = nullptr; // per type id, only set while sampling
+    cc::vector<int> novel_results;                           // per local index, executions that produced a new state
+    cc::vector<int> hashed_results;                          // per local index, executions that produced a hashable state
+
+    // invariant schedules (see function::check_every)
+    bool sparse_invariants = false;  // per session, replays always check densely
+    cc::vector<int> invariant_skips; // per local index, applications since the last every_k check
+    tg::rng schedule_rng;            // for probabilistic checks, independent of the op sampling
+
+    // swarm testing (see nx::mct_swarm)
+    cc::vector<bool> swarm_disabled; // per local index, per session
+
+    // NOTE: machines never write into the shared function objects, so multiple machines can run in parallel
     explicit machine(MonteCarloTest const* test) : test(test) {}
 
+    int index_of(function const* f) const
+    {
+        CC_ASSERT(0 <= f->idx && f->idx < int(local_indices.size()));
+        return local_indices[f->idx];
+    }
+
     bool has_values_to_execute(function const& f) const
     {
-        for (auto a : f.arg_types)
-            if (!values.get(a).has_values())
+        for (auto a : f.arg_type_ids)
+            if (!values[a].has_values())
                 return false;
         return true;
     }
 
-    static std::pair<machine, machine> build_equivalence_checker(MonteCarloTest& test, equivalence const& e, cc::vector<function*>& funs_a, cc::vector<function*>& funs_b)
+    /// collects the functions of the reference (funs_a) and of each implementation of an equivalence
+    /// funs_impls[k][i] corresponds to funs_a[i]
+    static void collect_equivalence_functions(MonteCarloTest& test,
+                                              equivalence const& e,
+                                              cc::vector<function*>& funs_a,
+                                              cc::vector<cc::vector<function*>>& funs_impls)
     {
         cc::set<function*> eq_funs;
         cc::map<std::type_index, cc::map<cc::string, function*>> eq_funs_by_type;
@@ -76,92 +392,103 @@ struct nx::MonteCarloTest::machine
         // register functions related to the equivalences
         for (auto const& e : test.mEquivalences)
         {
-            auto skip_a = bool(eq_funs_by_type.contains_key(e.type_a));
-            auto skip_b = bool(eq_funs_by_type.contains_key(e.type_b));
+            cc::vector<std::type_index> types;
+            types.push_back(e.type_a);
+            for (auto const& impl : e.impls)
+                types.push_back(impl.type);
+
+            cc::vector<bool> skip;
+            for (auto t : types)
+                skip.push_back(bool(eq_funs_by_type.contains_key(t)));
 
             for (auto& f : test.mFunctions)
             {
-                auto is_eq_a = false;
-                auto is_eq_b = false;
-
-                is_eq_a |= f.return_type == e.type_a;
-                is_eq_b |= f.return_type == e.type_b;
-                for (auto a : f.arg_types)
+                auto num_eq_types = 0;
+                for (auto ti = 0; ti < int(types.size()); ++ti)
                 {
-                    is_eq_a |= a == e.type_a;
-                    is_eq_b |= a == e.type_b;
-                }
+                    auto is_eq = f.return_type == types[ti];
+                    for (auto a : f.arg_types)
+                        is_eq |= a == types[ti];
 
-                CC_ASSERT(!(is_eq_a && is_eq_b) && "no function may 'bridge' between types checked for equivalence");
+                    if (!is_eq)
+                        continue;
 
-                if (is_eq_a || is_eq_b)
+                    ++num_eq_types;
                     eq_funs.add(&f);
-                if (is_eq_a && !skip_a)
-                {
-                    CC_ASSERTF(!eq_funs_by_type[e.type_a].contains_key(f.name.c_str()),
-                               "functions checked for equivalence need unique names (duplicate function '%s')", f.name);
-                    eq_funs_by_type[e.type_a][f.name.c_str()] = &f;
-                }
-                if (is_eq_b && !skip_b)
-                {
-                    CC_ASSERTF(!eq_funs_by_type[e.type_b].contains_key(f.name.c_str()),
-                               "functions checked for equivalence need unique names (duplicate function '%s')", f.name);
-                    eq_funs_by_type[e.type_b][f.name.c_str()] = &f;
+                    if (!skip[ti])
+                    {
+                        CC_ASSERTF(!eq_funs_by_type[types[ti]].contains_key(f.name.c_str()),
+                                   "functions checked for equivalence need unique names (duplicate function '%s')", f.name);
+                        eq_funs_by_type[types[ti]][f.name.c_str()] = &f;
+                    }
                 }
+
+                CC_ASSERT(num_eq_types <= 1 && "no function may 'bridge' between types checked for equivalence");
             }
         }
         CC_ASSERT(!eq_funs.empty() && "no functions found to check for equivalence");
 
-        // helper for collecting pairs of functions used for equivalence
-        auto const collect_functions = [&](std::type_index ta, std::type_index tb)
-        {
-            cc::vector<cc::pair<function*, function*>> funs;
-
-            // unrelated funs
-            for (auto& f : test.mFunctions)
-                if (!eq_funs.contains(&f) || f.is_invariant) // always add invariants
-                    funs.emplace_back(&f, &f);
+        funs_impls.resize(e.impls.size());
 
-            // type related funs
-            for (auto const& [name, fa] : eq_funs_by_type.get(ta))
+        // unrelated funs
+        for (auto& f : test.mFunctions)
+            if (!eq_funs.contains(&f) || f.is_invariant) // always add invariants
             {
-                if (!eq_funs_by_type.get(tb).contains_key(name))
+                funs_a.push_back(&f);
+                for (auto& funs : funs_impls)
+                    funs.push_back(&f);
+            }
+
+        // type related funs
+        for (auto const& [name, fa] : eq_funs_by_type.get(e.type_a))
+        {
+            auto missing = false;
+            for (auto const& impl : e.impls)
+                if (!eq_funs_by_type.get(impl.type).contains_key(name))
                 {
+                    missing = true;
                     if (fa->is_optional)
                         continue; // not strictly required
 
-                    RICH_LOG_ERROR("operation '{}' not found for type {}", name, tb.name());
+                    RICH_LOG_ERROR("operation '{}' not found for type {}", name, impl.type.name());
                     RICH_LOG_ERROR("(note: an exact match is required, subtyping may interfere with this)");
                 }
-                CC_ASSERT(eq_funs_by_type.get(tb).contains_key(name) && "all functions checked for equivalence need to be defined for both types");
-                auto fb = eq_funs_by_type.get(tb).get(name);
-                funs.emplace_back(fa, fb);
+            if (missing && fa->is_optional)
+                continue; // only executed if all implementations have it
+
+            CC_ASSERT(!missing && "all functions checked for equivalence need to be defined for all types");
+            funs_a.push_back(fa);
+            for (auto k = 0; k < int(e.impls.size()); ++k)
+            {
+                auto fb = eq_funs_by_type.get(e.impls[k].type).get(name);
+                funs_impls[k].push_back(fb);
 
                 // either both or neither can have a precondition
                 REQUIRE(bool(fa->precondition) == bool(fb->precondition));
-            }
 
-            return funs;
-        };
+                // consumed args empty their slots, which must happen on all sides
+                for (auto i = 0; i < fa->arity() && i < fb->arity(); ++i)
+                    REQUIRE(fa->arg_types_consumed[i] == fb->arg_types_consumed[i]);
+            }
+        }
 
-        // collect functions
-        auto funs = collect_functions(e.type_a, e.type_b);
-        for (auto i = 0; i < int(funs.size()); ++i)
+        // check signatures
+        for (auto k = 0; k < int(e.impls.size()); ++k)
         {
-            auto f_a = funs[i].first;
-            auto f_b = funs[i].second;
-
-            funs_a.push_back(f_a);
-            funs_b.push_back(f_b);
-
-            if (!f_a->is_invariant)
+            auto const type_b = e.impls[k].type;
+            for (auto i = 0; i < int(funs_a.size()); ++i)
             {
+                auto f_a = funs_a[i];
+                auto f_b = funs_impls[k][i];
+                if (f_a->is_invariant)
+                    continue;
+
                 if (f_a->return_type == e.type_a)
                 {
-                    if (f_b->return_type != e.type_b)
-                        RICH_LOG_ERROR("bisimulation return type mismatch for '{}': expected {}, got {}", f_a->name, cc::demangle(e.type_b.name()),
+                    if (f_b->return_type != type_b)
+                        RICH_LOG_ERROR("bisimulation return type mismatch for '{}': expected {}, got {}", f_a->name, cc::demangle(type_b.name()),
                                        cc::demangle(f_b->return_type.name()));
-                    CC_ASSERT(f_b->return_type == e.type_b);
+                    CC_ASSERT(f_b->return_type == type_b);
                 }
                 else
                 {
@@ -171,19 +498,17 @@ struct nx::MonteCarloTest::machine
                     CC_ASSERT(f_a->return_type == f_b->return_type);
                 }
 
-                for (auto i = 0; i < f_a->arity(); ++i)
+                for (auto ai = 0; ai < f_a->arity(); ++ai)
                 {
-                    CC_ASSERT(f_a->arg_types_could_change[i] == f_b->arg_types_could_change[i]);
+                    CC_ASSERT(f_a->arg_types_could_change[ai] == f_b->arg_types_could_change[ai]);
 
-                    if (f_a->arg_types[i] == e.type_a)
-                        CC_ASSERT(f_b->arg_types[i] == e.type_b);
+                    if (f_a->arg_types[ai] == e.type_a)
+                        CC_ASSERT(f_b->arg_types[ai] == type_b);
                     else
-                        CC_ASSERT(f_a->arg_types[i] == f_b->arg_types[i]);
+                        CC_ASSERT(f_a->arg_types[ai] == f_b->arg_types[ai]);
                 }
             }
         }
-
-        return {machine::build(test, funs_a), machine::build(test, funs_b)};
     }
 
     static machine build(MonteCarloTest const& test, cc::span<function> funs)
@@ -215,30 +540,27 @@ struct nx::MonteCarloTest::machine
         CC_ASSERTF(cc::set<function*>(funs).size() == funs.size(), "duplicate function in machine::build: %s", get_duplicate_fun_names());
         auto m = machine(&test);
 
-        // reset functions
-        for (auto f : funs)
-        {
-            f->executions = 0;
-            f->internal_idx = -1;
-        }
+        m.local_indices = cc::vector<int>::filled(test.mFunctions.size(), -1);
+        m.executions = cc::vector<int>::filled(funs.size(), 0);
+        m.cost_ms = cc::vector<double>::filled(funs.size(), 0.0);
+        m.cost_calls = cc::vector<int>::filled(funs.size(), 0);
+        m.invariant_skips = cc::vector<int>::filled(funs.size(), 0);
+        m.swarm_disabled = cc::vector<bool>::filled(funs.size(), false);
+        m.novel_results = cc::vector<int>::filled(funs.size(), 0);
+        m.hashed_results = cc::vector<int>::filled(funs.size(), 0);
+        m.values.resize(test.mTypes.size());
 
         for (int i = 0; i < int(funs.size()); ++i)
         {
             auto f = funs[i];
 
             // assign idx
-            CC_ASSERT(f->internal_idx == -1);
-            f->internal_idx = i;
-
-            // touch args and return types
-            for (auto a : f->arg_types)
-                m.values[a];
-            if (f->return_type != typeid(void))
-                m.values[f->return_type];
+            CC_ASSERT(m.local_indices[f->idx] == -1);
+            m.local_indices[f->idx] = i;
 
             if (f->is_invariant) // invariants
             {
-                for (auto a : f->arg_types)
+                for (auto a : f->arg_type_ids)
                     m.values[a].invariants.push_back(f);
             }
             else // normal function
@@ -246,15 +568,15 @@ struct nx::MonteCarloTest::machine
                 m.all_functions.push_back(f);
 
                 // register generators
-                if (f->return_type != typeid(void))
+                if (f->return_type_id >= 0)
                 {
-                    auto& vs = m.values[f->return_type];
+                    auto& vs = m.values[f->return_type_id];
 
                     vs.mutators_or_generators.push_back(f);
 
                     auto is_safe = true;
-                    for (auto a : f->arg_types)
-                        if (a == f->return_type)
+                    for (auto a : f->arg_type_ids)
+                        if (a == f->return_type_id)
                             is_safe = false;
 
                     if (is_safe)
@@ -265,13 +587,20 @@ struct nx::MonteCarloTest::machine
                 for (auto i = 0; i < f->arity(); ++i)
                     if (f->arg_types_could_change[i])
                     {
-                        auto& vs = m.values[f->arg_types[i]];
+                        auto& vs = m.values[f->arg_type_ids[i]];
                         if (vs.mutators_or_generators.empty() || vs.mutators_or_generators.back() != f)
                             vs.mutators_or_generators.push_back(f);
                     }
 
+                // register consumers
+                for (auto i = 0; i < f->arity(); ++i)
+                    if (f->arg_types_consumed[i])
+                        m.values[f->arg_type_ids[i]].has_consumers = true;
+
                 // init test function
                 m.test_functions.push_back(f);
+                if (f->sample_weight != 1)
+                    m.has_weights = true;
             }
         }
 
@@ -284,10 +613,10 @@ struct nx::MonteCarloTest::machine
     {
         // sanity checks
         for (auto f : all_functions)
-            for (auto a : f->arg_types)
-                if (!values.get(a).can_safely_generate())
+            for (auto a : f->arg_type_ids)
+                if (!values[a].can_safely_generate())
                 {
-                    RICH_LOG_ERROR("no way to generate type {}", a.name());
+                    RICH_LOG_ERROR("no way to generate type {}", test->mTypes[a].name());
                     return false;
                 }
 
@@ -309,11 +638,63 @@ struct nx::MonteCarloTest::machine
         return a;
     }
 
-    void remove_fulfilled_test_functions()
+    /// prepares the machine for a new session (keeps the topology, drops all values)
+    void reset()
+    {
+        for (auto& vs : values)
+            vs.vars.clear();
+        arena.reset(); // after all values are destroyed
+
+        for (auto& e : executions)
+            e = 0;
+        profile = nullptr; // re-attached per sampled session
+        profile_ops = 0;
+        time_ops = false;
+        weighted_sampling = false;
+        track_costs = false;
+        sparse_invariants = false;
+        for (auto& c : invariant_skips)
+            c = 0;
+        for (auto i = 0; i < int(swarm_disabled.size()); ++i)
+            swarm_disabled[i] = false;
+        visited_states = nullptr;
+        test_functions = all_functions; // non-invariant functions are exactly the test functions
+    }
+
+    /// copies all values (per type id) into a snapshot whose values live in the given arena
+    /// returns false if a value type is not copyable
+    bool save_values(cc::vector<cc::vector<value>>& snapshot, value_arena& snapshot_arena) const
+    {
+        for (auto t = 0; t < int(values.size()); ++t)
+            if (!values[t].vars.empty() && !test->mTypeMetadata[t].copy)
+                return false;
+
+        snapshot.clear();
+        snapshot.resize(values.size());
+        for (auto t = 0; t < int(values.size()); ++t)
+            for (auto const& v : values[t].vars)
+                snapshot[t].push_back(v.is_void() ? value() : test->mTypeMetadata[t].copy(v, snapshot_arena));
+        return true;
+    }
+
+    /// replaces all values by copies of a snapshot (see save_values)
+    void load_values(cc::span<cc::vector<value> const> snapshot)
+    {
+        CC_ASSERT(snapshot.size() == values.size());
+        for (auto t = 0; t < int(values.size()); ++t)
+        {
+            auto& vars = values[t].vars;
+            vars.clear();
+            for (auto const& v : snapshot[t])
+                vars.push_back(v.is_void() ? value() : test->mTypeMetadata[t].copy(v, arena));
+        }
+    }
+
+    void remove_fulfilled_test_functions(double scale)
     {
         for (auto i = int(test_functions.size()) - 1; i >= 0; --i)
         {
-            if (test_functions[i]->executions >= test_functions[i]->min_executions)
+            if (executions[index_of(test_functions[i])] >= int(std::ceil(test_functions[i]->min_executions * scale)))
             {
                 std::swap(test_functions[i], test_functions.back());
                 test_functions.pop_back();
@@ -321,10 +702,58 @@ struct nx::MonteCarloTest::machine
         }
     }
 
+    /// ops that swarm testing may disable, i.e. all but the safe generators (which keep every type constructible)
+    bool is_swarm_candidate(function const* f) const
+    {
+        if (f->return_type_id < 0)
+            return true;
+
+        for (auto g : values[f->return_type_id].safe_generators)
+            if (g == f)
+                return false;
+
+        return true;
+    }
+
+    /// removes f from the ops of this session (also as a fallback in try_generate_values_for)
+    void swarm_disable(function const* f)
+    {
+        swarm_disabled[index_of(f)] = true;
+
+        for (auto i = 0; i < int(test_functions.size()); ++i)
+            if (test_functions[i] == f)
+            {
+                std::swap(test_functions[i], test_functions.back());
+                test_functions.pop_back();
+                break;
+            }
+    }
+
+    /// disables each swarm candidate with probability 1/2, keeping at least one of them
+    /// appends the local indices of the disabled ops
+    void choose_swarm(tg::rng& rng, cc::vector<int>& disabled)
+    {
+        cc::vector<function*> candidates;
+        for (auto f : test_functions)
+            if (is_swarm_candidate(f))
+                candidates.push_back(f);
+
+        if (candidates.size() < 2)
+            return;
+
+        auto const kept = random_choice(rng, candidates);
+        for (auto f : candidates)
+            if (f != kept && rng() % 2 == 0)
+            {
+                swarm_disable(f);
+                disabled.push_back(index_of(f));
+            }
+    }
+
     function* sample_suitable_test_function(tg::rng& rng, int max_tries = 500) const
     {
         // randomly choose new unsatisfied function
-        auto f = random_choice(rng, test_functions);
+        auto f = weighted_sampling ? sample_weighted_test_function(rng) : random_choice(rng, test_functions);
 
         // find an executable function
         while (!has_values_to_execute(*f))
@@ -332,8 +761,8 @@ struct nx::MonteCarloTest::machine
             while (true) // no endless loop because at least one arg type must have no values
             {
                 // get a random parameter with no values
-                auto t = random_choice(rng, f->arg_types);
-                auto const& vs = values.get(t);
+                auto t = random_choice(rng, f->arg_type_ids);
+                auto const& vs = values[t];
                 if (!vs.has_values())
                 {
                     // try to execute a random safe generator
@@ -352,6 +781,56 @@ struct nx::MonteCarloTest::machine
         return f;
     }
 
+    /// picks a test function with probability proportional to its weight
+    /// with cost tracking, the weight is divided by the mean op cost so that ops get similar shares of time instead of calls
+    function* sample_weighted_test_function(tg::rng& rng) const
+    {
+        // ops without measurements are assumed to have the mean cost of the measured ones
+        auto default_cost = 0.0;
+        if (track_costs)
+        {
+            auto total_ms = 0.0;
+            auto total_calls = 0;
+            for (auto f : test_functions)
+            {
+                total_ms += cost_ms[index_of(f)];
+                total_calls += cost_calls[index_of(f)];
+            }
+            default_cost = total_calls > 0 ? total_ms / total_calls : 1.0;
+        }
+
+        auto const weight_of = [&](function const* f) -> double
+        {
+            auto const i = index_of(f);
+            double w = f->sample_weight;
+
+            if (track_costs)
+            {
+                auto const cost = cost_calls[i] > 0 ? cost_ms[i] / cost_calls[i] : default_cost;
+                w /= tg::max(cost, 1e-6); // clamped to 1 ns
+            }
+
+            // ops that rarely lead to new states are sampled less, but never starve
+            if (visited_states)
+                w *= tg::max(0.05, (novel_results[i] + 1.0) / (hashed_results[i] + 2.0));
+
+            return w;
+        };
+
+        auto total = 0.0;
+        for (auto f : test_functions)
+            total += weight_of(f);
+
+        auto r = uniform(rng, 0.0, total);
+        for (auto f : test_functions)
+        {
+            r -= weight_of(f);
+            if (r <= 0)
+                return f;
+        }
+        return test_functions.back(); // rounding
+    }
+
     bool try_sample_args_with_precondition(tg::rng& rng, function* f, cc::span<value*> args, cc::span<int> arg_indices, int max_tries = 10)
     {
         CC_ASSERT(has_values_to_execute(*f));
@@ -364,21 +843,70 @@ struct nx::MonteCarloTest::machine
             // collect args
             for (auto i = 0; i < arity; ++i)
             {
-                auto& vars = values.get(f->arg_types[i]).vars;
-                CC_ASSERT(!vars.empty());
-                auto ai = uniform(rng, size_t(0), vars.size() - 1);
-                args[i] = &vars[ai];
-                arg_indices[i] = int(ai);
+                auto& vs = values[f->arg_type_ids[i]];
+                auto const ai = sample_var_idx(rng, vs);
+                args[i] = &vs.vars[ai];
+                arg_indices[i] = ai;
             }
 
+            // a consumed value can only be passed once
+            if (f->consumes_args && !are_valid_args(f, args))
+                continue;
+
             // check precondition
-            if (!f->precondition || f->precondition(args))
+            if (!f->precondition)
+                break;
+
+            auto const ok = f->precondition(args);
+            if (profile)
+            {
+                auto& fs = profile->functions[f->idx];
+                fs.precondition_checks++;
+                if (!ok)
+                    fs.precondition_rejections++;
+            }
+            if (ok)
                 break;
         }
 
         return max_tries >= 0;
     }
 
+    /// uniformly random non-empty slot (see value_set::has_consumers)
+    static int sample_var_idx(tg::rng& rng, value_set const& vs)
+    {
+        CC_ASSERT(vs.has_values());
+        if (!vs.has_consumers)
+            return int(uniform(rng, size_t(0), vs.vars.size() - 1));
+
+        auto num_values = 0;
+        for (auto const& v : vs.vars)
+            num_values += int(!v.is_void());
+
+        auto n = uniform(rng, 0, num_values - 1);
+        for (auto i = 0; i < int(vs.vars.size()); ++i)
+            if (!vs.vars[i].is_void() && n-- == 0)
+                return i;
+        return -1; // unreachable
+    }
+
+    /// false if an arg slot is empty (consumed or never written) or a consumed arg is also passed as another arg
+    /// (only possible in replays of invalid traces, sampling never picks such args)
+    static bool are_valid_args(function const* f, cc::span<value* const> args)
+    {
+        for (auto i = 0; i < int(args.size()); ++i)
+        {
+            if (args[i]->is_void())
+                return false;
+
+            if (f->arg_types_consumed[i])
+                for (auto j = 0; j < int(args.size()); ++j)
+                    if (j != i && args[j] == args[i])
+                        return false;
+        }
+        return true;
+    }
+
     value execute(function* f, cc::span<value*> args, bool exec_invariants, int seed)
     {
         CC_ASSERT(int(args.size()) == f->arity());
@@ -386,85 +914,246 @@ struct nx::MonteCarloTest::machine
         // set to proper seed
         for (auto a : args)
             if (a->type == typeid(tg::rng))
-                ((tg::rng*)a->ptr)->seed(seed);
+                ((tg::rng*)a->get())->seed(seed);
 
-        auto v = f->execute(args);
-        f->executions++;
+        auto const t_op = track_costs ? profile_clock::now() : profile_clock::time_point();
+
+        value v;
+        if (profile || time_ops)
+        {
+            auto const t0 = profile_clock::now();
+            v = f->execute(args, arena);
+            last_op_ms = elapsed_ms(t0);
+            if (profile)
+                profile->record_execution(f, last_op_ms);
+        }
+        else
+            v = f->execute(args, arena);
+        executions[index_of(f)]++;
+
+        // consumed args were moved from, their slots stay empty until an op refills them
+        if (f->consumes_args)
+            for (auto i = 0; i < f->arity(); ++i)
+                if (f->arg_types_consumed[i])
+                    *args[i] = value();
+
+        if (visited_states)
+            record_states(f, v, args);
 
         if (exec_invariants)
             execute_invariants_for(f, v, args);
 
+        // op cost includes the invariants it triggers
+        if (track_costs)
+        {
+            cost_ms[index_of(f)] += elapsed_ms(t_op);
+            cost_calls[index_of(f)]++;
+        }
+
         return v;
     }
 
+    /// adds the states of the result and mutated args to the visited states
+    void record_states(function* f, value const& v, cc::span<value*> args)
+    {
+        auto is_hashed = false;
+        auto is_new = false;
+        auto const add_state = [&](value const& val, int type)
+        {
+            auto const& hash = test->mTypeMetadata[type].hash;
+            if (!hash || val.is_void())
+                return;
+
+            is_hashed = true;
+            auto& states = (*visited_states)[type];
+            auto const h = hash(val.get());
+            if (!states.contains(h))
+            {
+                states.add(h);
+                is_new = true;
+            }
+        };
+
+        for (auto i = 0; i < f->arity(); ++i)
+            if (f->arg_types_could_change[i])
+                add_state(*args[i], f->arg_type_ids[i]);
+        if (f->return_type_id >= 0)
+            add_state(v, f->return_type_id);
+
+        auto const li = index_of(f);
+        if (is_hashed)
+            hashed_results[li]++;
+        if (is_new)
+            novel_results[li]++;
+    }
+
     void execute_invariants_for(function* f, value& v, cc::span<value*> args)
     {
         // invariants for reference args
         for (int i = 0; i < f->arity(); ++i)
             if (f->arg_types_could_change[i])
-                execute_invariants_for(*args[i]);
+                execute_invariants_for(*args[i], f->arg_type_ids[i]);
 
         // verify invariants for return type
         if (!v.is_void())
-            execute_invariants_for(v);
+            execute_invariants_for(v, f->return_type_id);
+    }
+
+    void execute_invariants_for(value& v, int type)
+    {
+        for (auto const& f : values[type].invariants)
+            if (!sparse_invariants || is_invariant_due(f))
+                execute_invariant(f, v);
+    };
+
+    void execute_invariant(function* f, value& v)
+    {
+        CC_ASSERT(f->arity() == 1 && "currently only unary invariants supported");
+        CC_ASSERT(f->arg_types[0] == v.type);
+        value* vp = &v;
+        auto const t0 = profile ? profile_clock::now() : profile_clock::time_point();
+        auto iv = f->execute(cc::span<value*>(vp), arena);
+        if (profile)
+            profile->record_execution(f, elapsed_ms(t0));
+        if (iv.type == typeid(bool))
+            CHECK(*static_cast<bool*>(iv.get()));
     }
 
-    void execute_invariants_for(value& v)
+    bool is_invariant_due(function* f)
     {
-        for (auto const& f : values.get(v.type).invariants)
+        switch (f->invariant_schedule)
+        {
+        case function::check_schedule::always:
+            return true;
+        case function::check_schedule::every_k:
         {
-            CC_ASSERT(f->arity() == 1 && "currently only unary invariants supported");
-            CC_ASSERT(f->arg_types[0] == v.type);
-            value* vp = &v;
-            auto iv = f->execute(cc::span<value*>(vp));
-            if (iv.type == typeid(bool))
-                CHECK(*static_cast<bool*>(iv.ptr));
+            auto& skips = invariant_skips[index_of(f)];
+            if (++skips < f->invariant_every)
+                return false;
+            skips = 0;
+            return true;
         }
-    };
+        case function::check_schedule::probabilistic:
+            return uniform(schedule_rng, 0.0f, 1.0f) < f->invariant_probability;
+        case function::check_schedule::session_end:
+            return false;
+        }
+        return true;
+    }
 
-    void integrate_value(value v, int idx)
+    /// checks all sparsely scheduled invariants on all values that are still alive at session end
+    /// NOTE: values that were replaced or consumed before without being checked are not covered
+    void execute_deferred_invariants()
     {
-        if (v.is_void())
+        if (!sparse_invariants)
             return;
 
-        CC_ASSERT(idx >= 0);
-        auto& vs = values.get(v.type);
+        for (auto& vs : values)
+            for (auto f : vs.invariants)
+                if (f->invariant_schedule != function::check_schedule::always)
+                    for (auto& v : vs.vars)
+                        if (!v.is_void())
+                            execute_invariant(f, v);
+    }
 
-        // ensure proper size
-        while (idx >= int(vs.vars.size()))
-            vs.vars.push_back({});
+    /// samples the current value pool sizes (no-op without profile)
+    /// other_sides: the implementation machines of an equivalence check (types checked for equivalence only have values on one side)
+    void record_pool_sizes(cc::span<machine const> other_sides = {})
+    {
+        if (!profile)
+            return;
 
-        vs.vars[idx] = cc::move(v);
+        auto const bucket = tg::min(profile_ops++ / profile_stats::ops_per_bucket, profile_stats::max_buckets - 1);
+        for (auto t = 0; t < int(values.size()); ++t)
+        {
+            auto size = int(values[t].vars.size());
+            for (auto const& m : other_sides)
+                size = tg::max(size, int(m.values[t].vars.size()));
+            profile->record_pool_size(t, size, bucket);
+        }
     }
 
-    int generate_integrated_value_idx(tg::rng& rng, std::type_index type)
+    void integrate_value(value v, int type, int idx)
     {
-        if (type == typeid(void))
-            return -1;
+        // a void result here means the op returned one of its args (see function::may_return_arg)
+        // the slot is not touched then (sampling and exhaustive enumeration record no slot for those anyway)
+        if (idx < 0 || v.is_void())
+            return;
 
-        // add value (either new or replace)
-        auto& vs = values.get(type);
-        if (uniform(rng, 0.0f, 1.0f) <= 1 / (1.f + vs.vars.size()))
+        CC_ASSERT(test->mTypes[type] == v.type);
+        ensure_var(type, idx);
+        values[type].vars[idx] = cc::move(v);
+    }
+
+    /// true if the op of any side of an equivalence returned one of its args (see function::may_return_arg)
+    /// no side stores its result then, which keeps the value slots of all sides in sync
+    static bool has_returned_arg(value const& va, cc::span<value const> results_b)
+    {
+        if (va.get_returned_arg())
+            return true;
+        for (auto const& vb : results_b)
+            if (vb.get_returned_arg())
+                return true;
+        return false;
+    }
+
+    void ensure_var(int type, int idx)
+    {
+        CC_ASSERT(idx >= 0);
+        auto& vs = values[type];
+        while (idx >= int(vs.vars.size()))
+            vs.vars.push_back({});
+    }
+
+    int generate_integrated_value_idx(tg::rng& rng, int type)
+    {
+        if (type < 0)
+            return -1;
+
+        // empty slots are refilled first
+        auto& vs = values[type];
+        if (vs.has_consumers)
+            for (auto i = 0; i < int(vs.vars.size()); ++i)
+                if (vs.vars[i].is_void())
+                    return i;
+
+        // add value (either new or replace)
+        if (uniform(rng, 0.0f, 1.0f) <= 1 / (1.f + vs.vars.size()))
             return int(vs.vars.size());
         else
             return uniform(rng, 0, int(vs.vars.size()) - 1);
     }
 
+    /// slot for the result of f applied to the given args
+    /// ops that consume an arg of their return type write the result back into its slot (e.g. T&& -> T updates in place without copies)
+    int generate_result_idx(tg::rng& rng, function const* f, cc::span<int const> arg_indices)
+    {
+        if (f->consumes_args)
+            for (auto i = 0; i < f->arity(); ++i)
+                if (f->arg_types_consumed[i] && f->arg_type_ids[i] == f->return_type_id)
+                    return arg_indices[i];
+
+        return generate_integrated_value_idx(rng, f->return_type_id);
+    }
+
     function* try_generate_values_for(tg::rng& rng, function* ref, cc::span<value*> arg_buffer, cc::span<int> index_buffer)
     {
         CC_ASSERT(ref->arity() > 0 && "0-ary functions should never have failing preconditions");
 
+        if (profile)
+            profile->functions[ref->idx].fallbacks++;
+
         // 50/50 generating a suitable arg type or a random one
         function* f;
         if (rng() % 2 == 0)
         {
-            auto a = random_choice(rng, ref->arg_types);
-            f = random_choice(rng, values.get(a).mutators_or_generators);
+            auto a = random_choice(rng, ref->arg_type_ids);
+            f = random_choice(rng, values[a].mutators_or_generators);
         }
         else
             f = random_choice(rng, all_functions);
 
-        if (!has_values_to_execute(*f))
+        if (swarm_disabled[index_of(f)] || !has_values_to_execute(*f))
             return nullptr;
 
         // sample args and try to execute
@@ -477,6 +1166,560 @@ struct nx::MonteCarloTest::machine
     }
 };
 
+/// a machine_trace prepared for fast non-printing replay
+/// functions are resolved and args/return values are bound to value slots up front,
+/// so the replay loop does no lookups and (once the buffers are warm) no allocations
+struct nx::MonteCarloTest::compiled_trace
+{
+    struct instruction
+    {
+        function* fun_a = nullptr;
+        int args_start = 0;  // into arg_vars and binding::args
+        int return_var = -1; // -1 for void
+        int seed = -1;
+        bool has_precondition = false;
+    };
+
+    struct binding
+    {
+        cc::vector<value*> args;    // per arg_vars entry
+        cc::vector<value*> returns; // per instruction, nullptr for void
+    };
+
+    cc::vector<instruction> instructions;
+    cc::vector<int> arg_vars;        // var index per arg
+    cc::vector<function*> impl_funs; // per instruction and implementation (only for equivalence traces)
+    int num_impls = 0;
+    bool check_args = false; // ops can leave slots empty (see machine::are_valid_args)
+    binding bound_a;
+    cc::vector<binding> bound_impls; // per implementation
+    cc::vector<value> results_impls; // per implementation, results of the current instruction (empty between replays)
+
+    /// function of instruction ii for implementation k (-1 for the reference or normal traces)
+    function* fun(int ii, int k) const { return k < 0 ? instructions[ii].fun_a : impl_funs[ii * num_impls + k]; }
+
+    /// compiles all ops starting at first_op
+    /// funs_a/funs_impls map function indices for equivalence traces (empty for normal traces)
+    void compile(machine_trace const& t, int first_op, cc::span<function* const> funs_a, cc::span<cc::vector<function*> const> funs_impls)
+    {
+        instructions.clear();
+        arg_vars.clear();
+        impl_funs.clear();
+        num_impls = int(funs_impls.size());
+        bound_impls.resize(num_impls);
+
+        for (auto oi = first_op; oi < int(t.ops.size()); ++oi)
+        {
+            auto const& op = t.ops[oi];
+
+            auto& in = instructions.emplace_back();
+            in.fun_a = funs_a.empty() ? op.fun : funs_a[op.function_idx];
+            in.args_start = int(arg_vars.size());
+            in.return_var = op.return_value_idx;
+            in.seed = op.seed;
+            in.has_precondition = bool(in.fun_a->precondition);
+            for (auto const& funs : funs_impls)
+            {
+                auto const f = funs[op.function_idx];
+                impl_funs.push_back(f);
+                in.has_precondition |= bool(f->precondition);
+            }
+
+            for (auto ai = 0; ai < in.fun_a->arity(); ++ai)
+                arg_vars.push_back(t.arg_indices[op.args_start_idx + ai]);
+        }
+
+        // only needed for traces with ops that consume args or return them (also in the prefix before first_op)
+        check_args = false;
+        for (auto const& op : t.ops)
+            check_args |= op.fun->consumes_args || op.fun->may_return_arg;
+        for (auto f : impl_funs)
+            check_args |= f->may_return_arg;
+    }
+
+    /// binds all args and return values to the vars of a machine (impl: see fun)
+    /// vars are grown up front, so the bound pointers stay valid for the whole replay
+    void bind(machine& m, binding& b, int impl) const
+    {
+        for (auto ii = 0; ii < int(instructions.size()); ++ii)
+        {
+            auto const& in = instructions[ii];
+            auto const f = fun(ii, impl);
+            for (auto ai = 0; ai < f->arity(); ++ai)
+                m.ensure_var(f->arg_type_ids[ai], arg_vars[in.args_start + ai]);
+            if (in.return_var >= 0)
+                m.ensure_var(f->return_type_id, in.return_var);
+        }
+
+        b.args.resize(arg_vars.size());
+        b.returns.resize(instructions.size());
+        for (auto ii = 0; ii < int(instructions.size()); ++ii)
+        {
+            auto const& in = instructions[ii];
+            auto const f = fun(ii, impl);
+            for (auto ai = 0; ai < f->arity(); ++ai)
+                b.args[in.args_start + ai] = &m.values[f->arg_type_ids[ai]].vars[arg_vars[in.args_start + ai]];
+            b.returns[ii] = in.return_var >= 0 ? &m.values[f->return_type_id].vars[in.return_var] : nullptr;
+        }
+    }
+};
+
+/// machines are only built once per MCT (and per thread) and reset between sessions
+struct nx::MonteCarloTest::machine_cache
+{
+    /// the reference machine drives the ops, the implementation machines follow it
+    struct equivalence_machines
+    {
+        cc::vector<function*> funs_a;
+        cc::vector<cc::vector<function*>> funs_impls; // funs_impls[k][i] corresponds to funs_a[i]
+        machine m_a;
+        cc::vector<machine> m_impls; // per implementation of the equivalence
+
+        equivalence_machines(MonteCarloTest& test, equivalence const& e) : m_a(&test)
+        {
+            machine::collect_equivalence_functions(test, e, funs_a, funs_impls);
+            m_a = machine::build(test, funs_a);
+            for (auto& funs : funs_impls)
+                m_impls.push_back(machine::build(test, funs));
+        }
+    };
+
+    cc::unique_ptr<machine> normal;
+    cc::vector<cc::unique_ptr<equivalence_machines>> equivalences; // per test equivalence
+    compiled_trace compiled;                                       // replay buffers, reused across traces
+    profile_stats profile;                                         // only filled with nx::mct_profile
+    speedup_stats speedups;                                        // only filled with nx::mct_speedup
+    cc::vector<cc::set<uint64_t>> visited_states;                  // per type id, see setHasher
+
+    /// returns a fresh machine for a normal session
+    machine& get(MonteCarloTest& test)
+    {
+        if (!normal)
+            normal = cc::make_unique<machine>(machine::build(test, test.mFunctions));
+        else
+            normal->reset();
+        return *normal;
+    }
+
+    /// returns fresh machines for checking the given equivalence
+    equivalence_machines& get(MonteCarloTest& test, equivalence const& e)
+    {
+        auto const idx = int(&e - test.mEquivalences.data());
+        CC_ASSERT(0 <= idx && idx < int(test.mEquivalences.size()));
+
+        if (equivalences.empty())
+            equivalences.resize(test.mEquivalences.size());
+
+        auto& em = equivalences[idx];
+        if (!em)
+            em = cc::make_unique<equivalence_machines>(test, e);
+        else
+        {
+            em->m_a.reset();
+            for (auto& m : em->m_impls)
+                m.reset();
+        }
+        return *em;
+    }
+};
+
+/// machine snapshots taken every few ops while replaying a (failing) trace
+/// replays of traces with the same op prefix resume from the latest snapshot instead of the first op
+/// NOTE: only valid if ops do not touch global state (i.e. no session callbacks)
+struct nx::MonteCarloTest::replay_checkpoints
+{
+    static constexpr int max_checkpoints = 32;
+    static constexpr int min_trace_ops = 16;
+
+    struct checkpoint
+    {
+        int num_ops = 0;                                 // executed ops of the base trace
+        cc::vector<cc::vector<value>> a;                 // values per type id
+        cc::vector<cc::vector<cc::vector<value>>> impls; // per implementation machine of equivalence traces
+    };
+
+    value_arena arena; // NOTE: must outlive all snapshot values
+    machine_trace base;
+    cc::vector<checkpoint> checkpoints; // ascending num_ops
+    int interval = 1;
+
+    void start(machine_trace const& t)
+    {
+        checkpoints.clear();
+        arena.reset(); // after all values are destroyed
+        base = t;
+        interval = tg::max(1, int(t.ops.size()) / max_checkpoints);
+    }
+
+    /// called before executing op num_ops of the base trace
+    void record(int num_ops, machine const& m_a, cc::span<machine const> m_impls = {})
+    {
+        if (num_ops == 0 || num_ops % interval != 0)
+            return;
+
+        auto& cp = checkpoints.emplace_back();
+        cp.num_ops = num_ops;
+        auto ok = m_a.save_values(cp.a, arena);
+        cp.impls.resize(m_impls.size());
+        for (auto k = 0; ok && k < int(m_impls.size()); ++k)
+            ok = m_impls[k].save_values(cp.impls[k], arena);
+        if (!ok)
+            checkpoints.pop_back(); // non-copyable values, needs full replay
+    }
+
+    /// latest checkpoint whose ops are a prefix of the given trace (nullptr if none)
+    checkpoint const* find(machine_trace const& t) const
+    {
+        if (t.equiv != base.equiv || checkpoints.empty())
+            return nullptr;
+
+        auto const same_op = [&](int i)
+        {
+            auto const& oa = t.ops[i];
+            auto const& ob = base.ops[i];
+            if (oa.function_idx != ob.function_idx || oa.return_value_idx != ob.return_value_idx || oa.seed != ob.seed)
+                return false;
+            for (auto ai = 0; ai < oa.fun->arity(); ++ai)
+                if (t.arg_indices[oa.args_start_idx + ai] != base.arg_indices[ob.args_start_idx + ai])
+                    return false;
+            return true;
+        };
+
+        auto const max_prefix = tg::min(int(t.ops.size()), checkpoints.back().num_ops);
+        auto prefix = 0;
+        while (prefix < max_prefix && same_op(prefix))
+            ++prefix;
+
+        for (auto i = int(checkpoints.size()) - 1; i >= 0; --i)
+            if (checkpoints[i].num_ops <= prefix)
+                return &checkpoints[i];
+        return nullptr;
+    }
+};
+
+/// symbolic enumeration of all op sequences up to a given depth
+/// - return values always go to fresh slots (replacing a value can only reduce the reachable states)
+///   except for ops that may return one of their args, their results are only reached through the arg (see function::may_return_arg)
+/// - nullary ops marked make_deterministic() are executed at most once per sequence
+/// - adjacent independent ops are only enumerated in one canonical order
+struct nx::MonteCarloTest::exhaustive_enumerator
+{
+    struct fun_info
+    {
+        function* fun = nullptr; // nullptr for invariants
+        cc::vector<int> arg_types;
+        int return_type = -1;
+        bool has_rng = false;
+    };
+
+    cc::vector<fun_info> funs;             // per machine-local function index
+    cc::vector<int> counts;                // number of values per type
+    cc::vector<cc::vector<bool>> consumed; // per type and value, moved out by an op of the current sequence
+    cc::vector<bool> nullary_used;         // per deterministic op, see function::make_deterministic
+    int rng_type = -1;
+    int depth = 0;
+    int rng_choices = 1;
+    int seed_base = 0;
+
+    machine_trace trace;
+    cc::vector<int> arg_buffer; // max_arity entries per level (deeper levels must not clobber pending args)
+    int max_arity = 0;
+    cc::unique_function<bool(machine_trace const&)> emit; // returns false to stop enumeration
+    bool stopped = false;
+
+    exhaustive_enumerator(machine const& m, equivalence const* eq, int depth, int rng_choices, size_t seed)
+      : depth(depth), rng_choices(rng_choices), seed_base(int(seed % 10000))
+    {
+        rng_type = m.test->findTypeId(typeid(tg::rng));
+
+        funs.resize(m.executions.size());
+        for (auto f : m.all_functions)
+        {
+            auto& fi = funs[m.index_of(f)];
+            fi.fun = f;
+            fi.arg_types = f->arg_type_ids;
+            fi.return_type = f->return_type_id;
+            fi.has_rng = has_rng_arg(f->arg_types);
+        }
+
+        counts = cc::vector<int>::filled(m.values.size(), 0);
+        consumed.resize(m.values.size());
+        nullary_used = cc::vector<bool>::filled(funs.size(), false);
+        max_arity = m.max_arity();
+        arg_buffer = cc::vector<int>::filled(tg::max(1, depth) * max_arity, -1);
+        trace.start(eq);
+    }
+
+    void run() { expand(0); }
+
+    bool writes(machine_trace::op const& op, int type, int slot) const
+    {
+        auto const& fi = funs[op.function_idx];
+        if (fi.return_type == type && op.return_value_idx == slot)
+            return true;
+        if (type == rng_type)
+            return false; // rngs are reseeded per op, so mutating them is not observable
+        for (auto i = 0; i < int(fi.arg_types.size()); ++i)
+            if ((fi.fun->arg_types_could_change[i] || fi.fun->arg_types_consumed[i]) && fi.arg_types[i] == type
+                && trace.arg_indices[op.args_start_idx + i] == slot)
+                return true;
+        return false;
+    }
+    bool reads(machine_trace::op const& op, int type, int slot) const
+    {
+        auto const& fi = funs[op.function_idx];
+        for (auto i = 0; i < int(fi.arg_types.size()); ++i)
+            if (fi.arg_types[i] == type && trace.arg_indices[op.args_start_idx + i] == slot)
+                return true;
+        return false;
+    }
+    // true if b sees a write of a
+    bool depends_on(machine_trace::op const& a, machine_trace::op const& b) const
+    {
+        auto const& fa = funs[a.function_idx];
+        auto const accessed = [&](int type, int slot) { return reads(b, type, slot) || writes(b, type, slot); };
+
+        if (a.return_value_idx >= 0 && accessed(fa.return_type, a.return_value_idx))
+            return true;
+        for (auto i = 0; i < int(fa.arg_types.size()); ++i)
+            if ((fa.fun->arg_types_could_change[i] || fa.fun->arg_types_consumed[i]) && fa.arg_types[i] != rng_type
+                && accessed(fa.arg_types[i], trace.arg_indices[a.args_start_idx + i]))
+                return true;
+        return false;
+    }
+    // canonical order of independent ops
+    bool is_ordered(machine_trace::op const& a, machine_trace::op const& b) const
+    {
+        if (a.function_idx != b.function_idx)
+            return a.function_idx < b.function_idx;
+        for (auto i = 0; i < int(funs[a.function_idx].arg_types.size()); ++i)
+        {
+            auto const ia = trace.arg_indices[a.args_start_idx + i];
+            auto const ib = trace.arg_indices[b.args_start_idx + i];
+            if (ia != ib)
+                return ia < ib;
+        }
+        return a.seed <= b.seed;
+    }
+
+    void expand(int level)
+    {
+        auto children = 0;
+
+        if (level < depth)
+            for (auto fi_idx = 0; fi_idx < int(funs.size()) && !stopped; ++fi_idx)
+            {
+                auto const& fi = funs[fi_idx];
+                if (!fi.fun)
+                    continue;
+                if (fi.fun->is_deterministic && nullary_used[fi_idx])
+                    continue;
+
+                auto executable = true;
+                for (auto t : fi.arg_types)
+                    if (counts[t] == 0)
+                        executable = false;
+                if (executable)
+                    children += choose_args(level, fi_idx, 0);
+            }
+
+        if (children == 0 && level > 0 && !stopped)
+            stopped = !emit(trace);
+    }
+
+    bool is_consumed(int type, int slot) const { return slot < int(consumed[type].size()) && consumed[type][slot]; }
+    void set_consumed(fun_info const& fi, int const* args, bool v)
+    {
+        if (!fi.fun->consumes_args)
+            return;
+
+        for (auto i = 0; i < int(fi.arg_types.size()); ++i)
+            if (fi.fun->arg_types_consumed[i])
+            {
+                auto& c = consumed[fi.arg_types[i]];
+                if (int(c.size()) <= args[i])
+                    c.resize(args[i] + 1);
+                c[args[i]] = v;
+            }
+    }
+
+    int choose_args(int level, int fi_idx, int ai)
+    {
+        auto const& fi = funs[fi_idx];
+        auto const args = arg_buffer.data() + level * max_arity;
+
+        if (ai < int(fi.arg_types.size()))
+        {
+            auto children = 0;
+            for (auto v = 0; v < counts[fi.arg_types[ai]] && !stopped; ++v)
+            {
+                if (is_consumed(fi.arg_types[ai], v))
+                    continue;
+
+                args[ai] = v;
+                children += choose_args(level, fi_idx, ai + 1);
+            }
+            return children;
+        }
+
+        // a consumed value can only be passed once
+        if (fi.fun->consumes_args)
+            for (auto i = 0; i < int(fi.arg_types.size()); ++i)
+                for (auto j = 0; j < int(fi.arg_types.size()); ++j)
+                    if (i != j && fi.fun->arg_types_consumed[i] && fi.arg_types[i] == fi.arg_types[j] && args[i] == args[j])
+                        return 0;
+
+        // results of ops that may return one of their args get no slot, later ops reach them through the arg
+        // (a fresh slot would stay empty and every sequence reading it would be rejected by the replay)
+        auto const has_slot = fi.return_type >= 0 && !fi.fun->may_return_arg;
+
+        auto children = 0;
+        for (auto c = 0; c < (fi.has_rng ? rng_choices : 1) && !stopped; ++c)
+        {
+            machine_trace::op op;
+            op.function_idx = fi_idx;
+            op.fun = fi.fun;
+            op.seed = fi.has_rng ? (seed_base + c * 7919) % 10000 : -1;
+            op.return_value_idx = has_slot ? counts[fi.return_type] : -1;
+            op.args_start_idx = int(trace.arg_indices.size());
+            for (auto i = 0; i < int(fi.arg_types.size()); ++i)
+                trace.arg_indices.push_back(args[i]);
+
+            // skip non-canonical orders of independent ops
+            auto const& prev = level > 0 ? trace.ops.back() : op;
+            if (level > 0 && !depends_on(prev, op) && !depends_on(op, prev) && !is_ordered(prev, op))
+            {
+                for (auto i = 0; i < int(fi.arg_types.size()); ++i)
+                    trace.arg_indices.pop_back();
+                continue;
+            }
+
+            trace.ops.push_back(op);
+            if (has_slot)
+                counts[fi.return_type]++;
+            set_consumed(fi, args, true);
+            auto const was_used = nullary_used[fi_idx];
+            nullary_used[fi_idx] = true;
+
+            expand(level + 1);
+            ++children;
+
+            nullary_used[fi_idx] = was_used;
+            set_consumed(fi, args, false);
+            if (has_slot)
+                counts[fi.return_type]--;
+            trace.ops.pop_back();
+            for (auto i = 0; i < int(fi.arg_types.size()); ++i)
+                trace.arg_indices.pop_back();
+        }
+        return children;
+    }
+};
+
+namespace
+{
+constexpr size_t arena_block_size = 64 * 1024;
+}
+
+void* nx::MonteCarloTest::value_arena::allocate(size_t size, size_t align)
+{
+    CC_ASSERT(align > 0 && align <= alignof(std::max_align_t));
+
+    // large values get their own block (keeps the current one)
+    if (size > arena_block_size / 4)
+    {
+        auto p = static_cast<std::byte*>(::operator new(size));
+        large_blocks.push_back(p);
+        return p;
+    }
+
+    auto const padding = (align - reinterpret_cast<uintptr_t>(head) % align) % align;
+    if (head == nullptr || padding + size > remaining)
+    {
+        // reuse blocks from before the last reset
+        ++current_block;
+        if (current_block == int(blocks.size()))
+            blocks.push_back(static_cast<std::byte*>(::operator new(arena_block_size)));
+        head = blocks[current_block];
+        remaining = arena_block_size;
+        return allocate(size, align);
+    }
+
+    auto p = head + padding;
+    head = p + size;
+    remaining -= padding + size;
+    return p;
+}
+
+void nx::MonteCarloTest::value_arena::reset()
+{
+    for (auto b : large_blocks)
+        ::operator delete(b);
+    large_blocks.clear();
+    current_block = -1;
+    head = nullptr;
+    remaining = 0;
+}
+
+nx::MonteCarloTest::value_arena::value_arena(value_arena&& rhs) noexcept
+  : blocks(cc::move(rhs.blocks)), large_blocks(cc::move(rhs.large_blocks)), current_block(rhs.current_block), head(rhs.head), remaining(rhs.remaining)
+{
+    rhs.blocks.clear();
+    rhs.large_blocks.clear();
+    rhs.reset();
+}
+
+nx::MonteCarloTest::value_arena& nx::MonteCarloTest::value_arena::operator=(value_arena&& rhs) noexcept
+{
+    if (this != &rhs)
+    {
+        release();
+        blocks = cc::move(rhs.blocks);
+        large_blocks = cc::move(rhs.large_blocks);
+        current_block = rhs.current_block;
+        head = rhs.head;
+        remaining = rhs.remaining;
+        rhs.blocks.clear();
+        rhs.large_blocks.clear();
+        rhs.reset();
+    }
+    return *this;
+}
+
+nx::MonteCarloTest::value_arena::~value_arena() { release(); }
+
+void nx::MonteCarloTest::value_arena::release()
+{
+    reset();
+    for (auto b : blocks)
+        ::operator delete(b);
+    blocks.clear();
+}
+
+int nx::MonteCarloTest::typeIdOf(std::type_index type)
+{
+    if (auto id = findTypeId(type); id >= 0)
+        return id;
+
+    mTypeIds[type] = int(mTypes.size());
+    mTypes.push_back(type);
+    mTypeMetadata.emplace_back();
+    return int(mTypes.size()) - 1;
+}
+
+int nx::MonteCarloTest::findTypeId(std::type_index type) const
+{
+    return mTypeIds.contains_key(type) ? mTypeIds.get(type) : -1;
+}
+
+void nx::MonteCarloTest::assignTypeIds(function& f)
+{
+    f.arg_type_ids.clear();
+    for (auto t : f.arg_types)
+        f.arg_type_ids.push_back(typeIdOf(t));
+    f.return_type_id = f.return_type == typeid(void) ? -1 : typeIdOf(f.return_type);
+}
+
 void nx::MonteCarloTest::addPreSessionCallback(cc::unique_function<void()> f)
 {
     CC_CONTRACT(f);
@@ -516,6 +1759,10 @@ void nx::MonteCarloTest::implExecute()
     mCurrentTrace = &trace;
     CC_DEFER { mCurrentTrace = nullptr; };
 
+    machine_cache machines;
+    mMachines = &machines;
+    CC_DEFER { mMachines = nullptr; };
+
     auto test = nx::detail::get_current_test();
 
     CC_ASSERT(!test->shouldFail() && "should-fail tests not supported for MCT");
@@ -530,6 +1777,13 @@ void nx::MonteCarloTest::implExecute()
         return;
     }
 
+    // benchmark a recorded workload (see --bench-trace)
+    if (!test->benchTrace().empty())
+    {
+        benchmarkTrace(deserializeTrace(nx::detail::trace_decode(test->benchTrace())));
+        return;
+    }
+
     auto const runMCT = [&]
     {
         // run fixed reproductions
@@ -539,7 +1793,17 @@ void nx::MonteCarloTest::implExecute()
             replayTrace(trace, false);
         }
 
-        if (test->isEndless()) // endless exec
+        if (test->isExhaustive()) // bounded-exhaustive exec
+        {
+            if (!tryExecuteExhaustive(trace, test->exhaustiveDepth(), test->exhaustiveRngChoices()))
+                throw nx::detail::assertion_failed_exception(); // trace is minimized below
+        }
+        else if (auto const num_threads = sessionThreads(); num_threads > 1) // parallel sessions
+        {
+            if (!tryExecuteSessionsParallel(trace, num_threads, test->isEndless()))
+                throw nx::detail::assertion_failed_exception(); // trace is minimized below
+        }
+        else if (test->isEndless()) // endless exec
         {
             RICH_LOG("endless MONTE_CARLO_TEST(\"%s\")", test->name());
 
@@ -550,7 +1814,7 @@ void nx::MonteCarloTest::implExecute()
             while (true)
             {
                 trace = {};
-                tryExecuteMachineNormally(trace, seed_rng());
+                tryExecuteMachineNormally(*mMachines, trace, seed_rng());
 
                 // progress report
                 auto t1 = std::chrono::high_resolution_clock::now();
@@ -558,17 +1822,36 @@ void nx::MonteCarloTest::implExecute()
                 if (t1 - t0 > 1000ms)
                 {
                     t0 = t1;
-                    RICH_LOG("endless MONTE_CARLO_TEST: %s assertions", nx::detail::number_of_assertions() - assert_cnt_start);
+                    if (mTrackStates)
+                    {
+                        auto num_states = 0;
+                        for (auto const& states : mMachines->visited_states)
+                            num_states += int(states.size());
+                        RICH_LOG("endless MONTE_CARLO_TEST: %s assertions, %s distinct states", nx::detail::number_of_assertions() - assert_cnt_start, num_states);
+                    }
+                    else
+                        RICH_LOG("endless MONTE_CARLO_TEST: %s assertions", nx::detail::number_of_assertions() - assert_cnt_start);
                 }
             }
         }
         else // single execution
         {
             trace = {};
-            tryExecuteMachineNormally(trace, get_seed());
+            tryExecuteMachineNormally(*mMachines, trace, get_seed());
         }
     };
 
+    // report after minimization and replay (also for failing runs)
+    CC_DEFER
+    {
+        if (machines.profile.is_active())
+            reportProfile(machines.profile);
+        if (machines.speedups.is_active())
+            reportSpeedups(machines.speedups);
+        if (!machines.visited_states.empty())
+            reportCoverage(machines.visited_states);
+    };
+
     if (test->isDebug())
     {
         runMCT();
@@ -581,20 +1864,33 @@ void nx::MonteCarloTest::implExecute()
     nx::detail::overwrite_assertion_handlers();
 
     // first: try normal execution
+    auto failed = false;
     try
     {
         runMCT();
     }
     catch (nx::detail::assertion_failed_exception const&)
     {
+        failed = true;
+
         // on fail: try to minimize trace
         RICH_LOG_ERROR("MONTE_CARLO_TEST failed. Trying to generate minimal reproduction.");
         minimizeTrace(trace);
         RICH_LOG_ERROR(".. done. result:");
+        reportSwarmConfiguration(trace);
 
         // set reproduction BEFORE actually executing it
         test->setReproduce(reproduce(trace.serialize_to_string(*this)));
 
+        if (!test->traceSaveDir().empty())
+        {
+            auto const filename = trace_file_name(test->traceSaveDir(), test->name());
+            if (nx::detail::trace_write_file(filename, trace.serialize(*this)))
+                RICH_LOG_ERROR("saved failing trace to '{}' (replay via --repr @{})", filename, filename);
+            else
+                RICH_LOG_WARN("could not write trace file '{}' (does the directory exist?)", filename);
+        }
+
         nx::detail::is_silenced() = false;
         nx::detail::always_terminate() = false;
         fflush(stdout);
@@ -606,9 +1902,125 @@ void nx::MonteCarloTest::implExecute()
 
     nx::detail::always_terminate() = false;
     nx::detail::reset_assertion_handlers();
+
+    // performance regressions have no reproduction, so they are only checked once the behavior matched
+    if (!failed && machines.speedups.is_active() && test->mctMaxSlowdown() > 0)
+        checkSpeedups(machines.speedups, test->mctMaxSlowdown());
+
+    // workload of the sampled session (only kept for single-threaded, non-exhaustive runs)
+    auto const has_workload = !failed && !trace.ops.empty() && !test->isExhaustive() && sessionThreads() == 1;
+
+    if (!test->traceCaptureDir().empty())
+    {
+        auto const filename = trace_file_name(test->traceCaptureDir(), test->name());
+        if (!has_workload)
+            RICH_LOG_WARN("no session trace to capture for '{}' (only for passing, single-threaded sampling)", test->name());
+        else if (nx::detail::trace_write_file(filename, trace.serialize(*this)))
+            RICH_LOG("captured session trace of '{}' ({} ops) to '{}' (benchmark via --bench-trace {})", test->name(), trace.ops.size(), filename, filename);
+        else
+            RICH_LOG_WARN("could not write trace file '{}' (does the directory exist?)", filename);
+    }
+
+    if (test->isMctBenchmark() && has_workload)
+        benchmarkTrace(trace);
+}
+
+int nx::MonteCarloTest::sessionThreads() const
+{
+    auto const test = nx::detail::get_current_test();
+    if (test->isDebug() || !mAllowParallelSessions || test->isMctBenchmark() || test->mctThreads() < 0)
+        return 1;
+
+    return test->mctThreads() == 0 ? nx::detail::hardware_threads() : test->mctThreads();
 }
 
-void nx::MonteCarloTest::tryExecuteMachineNormally(machine_trace& trace, size_t seed)
+bool nx::MonteCarloTest::tryExecuteSessionsParallel(machine_trace& failing_trace, int num_threads, bool endless)
+{
+    auto const base_seed = get_seed();
+
+    std::atomic<bool> stop = false;
+    std::atomic<long long> num_assertions = 0;
+
+    std::mutex fail_mutex;
+    auto failed = false;
+    std::exception_ptr error; // non-check exceptions are rethrown on the calling thread
+
+    if (endless)
+        RICH_LOG("endless MONTE_CARLO_TEST(\"%s\") on %s threads", nx::detail::get_current_test()->name(), num_threads);
+
+    // machines are not thread-safe, so each thread gets its own
+    cc::vector<machine_cache> thread_machines;
+    thread_machines.resize(num_threads);
+
+    nx::detail::run_parallel(num_threads,
+                             [&](int thread)
+                             {
+                                 // thread 0 sees the same seeds as a single-threaded execution
+                                 auto const thread_seed = base_seed + size_t(thread) * 0x9E3779B97F4A7C15uLL;
+                                 tg::rng seed_rng;
+                                 seed_rng.seed(thread_seed);
+
+                                 auto t0 = std::chrono::high_resolution_clock::now();
+                                 machine_trace trace;
+                                 do
+                                 {
+                                     auto const assert_cnt_start = nx::detail::number_of_assertions();
+                                     trace = {};
+                                     try
+                                     {
+                                         tryExecuteMachineNormally(thread_machines[thread], trace, endless ? seed_rng() : thread_seed);
+                                     }
+                                     catch (nx::detail::assertion_failed_exception const&)
+                                     {
+                                         auto lock = std::lock_guard(fail_mutex);
+                                         if (!failed)
+                                         {
+                                             failed = true;
+                                             failing_trace = cc::move(trace);
+                                         }
+                                         stop = true;
+                                     }
+                                     catch (...)
+                                     {
+                                         auto lock = std::lock_guard(fail_mutex);
+                                         if (!error)
+                                             error = std::current_exception();
+                                         stop = true;
+                                     }
+                                     num_assertions += nx::detail::number_of_assertions() - assert_cnt_start;
+
+                                     // progress report
+                                     auto t1 = std::chrono::high_resolution_clock::now();
+                                     using namespace std::chrono_literals;
+                                     if (endless && thread == 0 && t1 - t0 > 1000ms)
+                                     {
+                                         t0 = t1;
+                                         RICH_LOG("endless MONTE_CARLO_TEST: %s assertions", num_assertions.load());
+                                     }
+                                 } while (endless && !stop);
+                             });
+
+    if (error)
+        std::rethrow_exception(error);
+
+    for (auto const& tm : thread_machines)
+    {
+        mMachines->profile.merge(tm.profile);
+        mMachines->speedups.merge(tm.speedups);
+
+        if (!tm.visited_states.empty())
+        {
+            mMachines->visited_states.resize(tm.visited_states.size());
+            for (auto t = 0; t < int(tm.visited_states.size()); ++t)
+                for (auto h : tm.visited_states[t])
+                    mMachines->visited_states[t].add(h);
+        }
+    }
+
+    return !failed;
+}
+
+void nx::MonteCarloTest::tryExecuteMachineNormally(machine_cache& machines, machine_trace& trace, size_t seed)
 {
     auto verbose = detail::get_current_test()->isVerbose();
 
@@ -627,8 +2039,83 @@ void nx::MonteCarloTest::tryExecuteMachineNormally(machine_trace& trace, size_t
             f();
     };
 
+    // session length: either until every op reached its execute_at_least count or a budget (see nx::mct_ops and nx::mct_time)
+    auto const* test = detail::get_current_test();
+    auto const scale = test->mctScale();
+    auto const budget_ops = test->mctOps() > 0 ? tg::max(1, int(std::ceil(test->mctOps() * scale))) : 0;
+    auto const budget_ms = test->mctTimeMs() * scale;
+    auto const has_budget = budget_ops > 0 || budget_ms > 0;
+    auto session_start = profile_clock::now();
+    auto const session_done = [&](machine const& m)
+    {
+        if (!has_budget)
+            return m.test_functions.empty();
+
+        if (budget_ops > 0 && int(trace.ops.size()) >= budget_ops)
+            return true;
+        if (budget_ms > 0 && elapsed_ms(session_start) >= budget_ms)
+            return true;
+        return false;
+    };
+    if (mTrackStates && machines.visited_states.empty())
+        machines.visited_states.resize(mTypes.size());
+    auto const prepare_sampling = [&](machine& m)
+    {
+        m.weighted_sampling = has_budget || m.has_weights || mTrackStates;
+        m.track_costs = has_budget;
+        m.sparse_invariants = true;
+        m.schedule_rng.seed(seed);
+        if (mTrackStates)
+            m.visited_states = &machines.visited_states;
+    };
+
+    // swarm testing (see nx::mct_swarm)
+    // the configuration has its own rng so that choosing it does not shift the op sampling
+    auto const swarm = test->isMctSwarm();
+    auto const choose_swarm = [&](machine& m)
+    {
+        if (!swarm)
+            return;
+
+        tg::rng swarm_rng;
+        swarm_rng.seed(seed ^ 0x9E3779B97F4A7C15uLL);
+        trace.is_swarm = true;
+        m.choose_swarm(swarm_rng, trace.swarm_disabled);
+
+        if (verbose)
+            RICH_LOG(" .. swarm: disabled {} of {} ops", trace.swarm_disabled.size(), m.all_functions.size());
+    };
+    // a configuration can disable every op that establishes some precondition (e.g. 'pop' without 'push')
+    // so ops that keep failing their preconditions are disabled as well
+    // NOTE: the safe generators are never disabled, so test_functions can only run empty once the session is done anyway
+    auto const swarm_drop_stuck = [&](machine& m, function* f, int& unsuccessful_count)
+    {
+        if (!swarm || unsuccessful_count < 100 || !m.is_swarm_candidate(f))
+            return;
+
+        m.swarm_disable(f);
+        trace.swarm_disabled.push_back(m.index_of(f));
+        unsuccessful_count = 0;
+
+        if (verbose)
+            RICH_LOG(" .. swarm: disabled [{}] (preconditions never met)", f->name);
+    };
+
+    // profiling (see nx::mct_profile)
+    auto const profiling = test->isMctProfile();
+    if (profiling)
+    {
+        machines.profile.init(*this);
+        machines.profile.sessions++;
+    }
+
+    // differential timing of equivalences (see nx::mct_speedup)
+    auto const timing = test->isMctSpeedup() && !mEquivalences.empty();
+    if (timing)
+        machines.speedups.init(*this);
+
     // helper
-    auto const add_trace = [&trace, verbose](function* f, int vi, cc::span<int> arg_indices, int seed)
+    auto const add_trace = [&trace, verbose](machine const& m, function* f, int vi, cc::span<int> arg_indices, int seed)
     {
         CC_ASSERT(f->arity() == int(arg_indices.size()));
 
@@ -640,7 +2127,7 @@ void nx::MonteCarloTest::tryExecuteMachineNormally(machine_trace& trace, size_t
 
         machine_trace::op op;
         op.seed = seed;
-        op.function_idx = f->internal_idx;
+        op.function_idx = m.index_of(f);
         op.fun = f;
         op.args_start_idx = int(trace.arg_indices.size());
         op.return_value_idx = vi;
@@ -656,14 +2143,18 @@ void nx::MonteCarloTest::tryExecuteMachineNormally(machine_trace& trace, size_t
         rng.seed(seed);
         trace.start(nullptr);
 
-        // build machine
-        auto m = machine::build(*this, mFunctions);
+        // reuse machine
+        auto& m = machines.get(*this);
+        if (profiling)
+            m.profile = &machines.profile;
+        prepare_sampling(m);
+        choose_swarm(m);
 
         // execute
         auto args_buffer = cc::array<value*>::filled(m.max_arity(), nullptr);
         auto index_buffer = cc::array<int>::filled(m.max_arity(), -1);
         auto unsuccessful_count = 0;
-        while (!m.test_functions.empty())
+        while (!session_done(m))
         {
             if (unsuccessful_count > 1000)
             {
@@ -693,30 +2184,49 @@ void nx::MonteCarloTest::tryExecuteMachineNormally(machine_trace& trace, size_t
                     args = cc::span<value*>(args_buffer).subspan(0, ff->arity());
 
                     // add trace
-                    auto vi = m.generate_integrated_value_idx(rng, ff->return_type);
-                    add_trace(ff, vi, cc::span<int>(index_buffer.data(), ff->arity()), seed);
+                    auto const ff_indices = cc::span<int>(index_buffer.data(), ff->arity());
+                    auto vi = m.generate_result_idx(rng, ff, ff_indices);
+                    add_trace(m, ff, vi, ff_indices, seed);
 
                     // execute
                     auto v = m.execute(ff, args, true, seed);
-                    m.integrate_value(cc::move(v), vi);
+                    if (v.is_void() && vi >= 0)
+                    {
+                        // returned one of its args (see function::may_return_arg), the slot keeps its value
+                        trace.ops.back().return_value_idx = -1;
+                        vi = -1;
+                    }
+                    m.integrate_value(cc::move(v), ff->return_type_id, vi);
+                    m.record_pool_sizes();
                 }
 
                 ++unsuccessful_count;
+                swarm_drop_stuck(m, f, unsuccessful_count);
                 continue;
             }
 
             // add trace
-            auto vi = m.generate_integrated_value_idx(rng, f->return_type);
-            add_trace(f, vi, arg_indices, seed);
+            auto vi = m.generate_result_idx(rng, f, arg_indices);
+            add_trace(m, f, vi, arg_indices, seed);
 
             // execute function
             auto v = m.execute(f, args, true, seed);
-            m.integrate_value(cc::move(v), vi);
+            if (v.is_void() && vi >= 0)
+            {
+                // returned one of its args (see function::may_return_arg), the slot keeps its value
+                trace.ops.back().return_value_idx = -1;
+                vi = -1;
+            }
+            m.integrate_value(cc::move(v), f->return_type_id, vi);
+            m.record_pool_sizes();
             unsuccessful_count = 0;
 
             // remove satisfied test functions
-            m.remove_fulfilled_test_functions();
+            if (!has_budget)
+                m.remove_fulfilled_test_functions(scale);
         }
+
+        m.execute_deferred_invariants();
     }
     else // equivalence checker
     {
@@ -727,26 +2237,49 @@ void nx::MonteCarloTest::tryExecuteMachineNormally(machine_trace& trace, size_t
             tg::rng rng;
             rng.seed(seed);
             trace.start(&e);
+            session_start = profile_clock::now(); // every equivalence gets the full budget
+
+            // reuse machines
+            auto& em = machines.get(*this, e);
+            auto& m_a = em.m_a;
+            auto const num_impls = int(em.m_impls.size());
+            prepare_sampling(m_a); // the implementations follow the ops sampled by m_a
+            choose_swarm(m_a);
+            if (profiling)
+                m_a.profile = &machines.profile;
+            auto const eq_idx = int(&e - mEquivalences.data());
+            m_a.time_ops = timing;
+            for (auto& m_b : em.m_impls)
+            {
+                REQUIRE(m_a.max_arity() == m_b.max_arity());
+                m_b.time_ops = timing;
+                if (profiling)
+                    m_b.profile = &machines.profile;
+                m_b.sparse_invariants = true;
+                m_b.schedule_rng.seed(seed);
+                m_b.visited_states = m_a.visited_states;
+            }
 
-            // prepare machines
-            cc::vector<function*> funs_a;
-            cc::vector<function*> funs_b;
-            auto machines = machine::build_equivalence_checker(*this, e, funs_a, funs_b);
-            auto& m_a = machines.first;
-            auto& m_b = machines.second;
-            REQUIRE(m_a.max_arity() == m_b.max_arity());
+            // per implementation buffers
+            auto args_buffers_b = cc::vector<cc::array<value*>>();
+            auto results_b = cc::vector<value>();
+            for (auto k = 0; k < num_impls; ++k)
+            {
+                args_buffers_b.push_back(cc::array<value*>::filled(m_a.max_arity(), nullptr));
+                results_b.emplace_back();
+            }
 
             // helper functions
-            auto const prepare_execution_b = [&m_b](function* f_b, cc::span<int> arg_indices, cc::span<value*> args_b)
+            auto const prepare_execution_b = [&](int k, function* f_b, cc::span<int> arg_indices)
             {
+                auto args_b = cc::span<value*>(args_buffers_b[k].data(), f_b->arity());
                 CC_ASSERT(arg_indices.size() == args_b.size());
-                CC_ASSERT(int(args_b.size()) == f_b->arity());
 
                 for (auto i = 0; i < int(arg_indices.size()); ++i)
                 {
-                    auto tb = f_b->arg_types[i];
+                    auto tb = f_b->arg_type_ids[i];
                     auto ai = arg_indices[i];
-                    auto& vars = m_b.values.get(tb).vars;
+                    auto& vars = em.m_impls[k].values[tb].vars;
                     CC_ASSERT(0 <= ai && ai < int(vars.size()));
 
                     args_b[i] = &vars[ai];
@@ -755,148 +2288,328 @@ void nx::MonteCarloTest::tryExecuteMachineNormally(machine_trace& trace, size_t
                 if (f_b->precondition)
                     CC_ASSERTF(f_b->precondition(args_b), "first precondition was true but second was not (of '%s')", f_b->name);
             };
-            auto const bi_execution = [this, &m_a, &m_b, &e, &add_trace](tg::rng& rng, function* f_a, function* f_b, cc::span<value*> args_a,
-                                                                         cc::span<value*> args_b, cc::span<int> arg_indices)
+            auto const multi_execution = [&](tg::rng& rng, function* f_a, cc::span<value*> args_a, cc::span<int> arg_indices)
             {
-                CC_ASSERT(f_a->internal_idx == f_b->internal_idx);
-                CC_ASSERT(f_a->arity() == f_b->arity());
                 CC_ASSERT(f_a->arity() == int(args_a.size()));
-                CC_ASSERT(f_b->arity() == int(args_b.size()));
+                auto const fi = m_a.index_of(f_a);
+
+                // bind the same value slots on all implementations
+                for (auto k = 0; k < num_impls; ++k)
+                {
+                    auto f_b = em.funs_impls[k][fi];
+                    CC_ASSERT(em.m_impls[k].index_of(f_b) == fi);
+                    CC_ASSERT(f_a->arity() == f_b->arity());
+                    prepare_execution_b(k, f_b, arg_indices);
+                }
 
                 auto const seed = uniform(rng, 0, 9999);
 
                 // add trace
-                auto vi = m_a.generate_integrated_value_idx(rng, f_a->return_type);
-                add_trace(f_a, vi, arg_indices, seed);
+                auto vi = m_a.generate_result_idx(rng, f_a, arg_indices);
+                add_trace(m_a, f_a, vi, arg_indices, seed);
 
                 auto va = m_a.execute(f_a, args_a, true, seed);
-                auto vb = m_b.execute(f_b, args_b, true, seed);
+                for (auto k = 0; k < num_impls; ++k)
+                {
+                    auto f_b = em.funs_impls[k][fi];
+                    auto args_b = cc::span<value*>(args_buffers_b[k].data(), f_b->arity());
+                    results_b[k] = em.m_impls[k].execute(f_b, args_b, true, seed);
+                    if (timing && f_a != f_b) // ops unrelated to the equivalence run the same function on all sides
+                        machines.speedups.record(eq_idx, k, f_a, m_a.last_op_ms, em.m_impls[k].last_op_ms);
+
+                    // test equivalence
+                    checkEquivalentResults(e, k, f_a, f_b, va, results_b[k], args_a, args_b);
+                }
 
-                // test equivalence
-                if (va.type == e.type_a)
+                // if any side returned one of its args, no side stores its result (keeps the value slots in sync)
+                if (machine::has_returned_arg(va, results_b))
                 {
-                    CC_ASSERT(vb.type == e.type_b && "type mismatch");
-                    e.test(va, vb);
+                    trace.ops.back().return_value_idx = -1;
+                    vi = -1;
                 }
-                else
+
+                // reintegrate values
+                m_a.integrate_value(cc::move(va), f_a->return_type_id, vi);
+                for (auto k = 0; k < num_impls; ++k)
+                    em.m_impls[k].integrate_value(cc::move(results_b[k]), em.funs_impls[k][fi]->return_type_id, vi);
+                m_a.record_pool_sizes(em.m_impls);
+            };
+
+            // execute
+            auto args_buffer_a = cc::array<value*>::filled(m_a.max_arity(), nullptr);
+            auto index_buffer = cc::array<int>::filled(m_a.max_arity(), -1);
+            auto unsuccessful_count = 0;
+            while (!session_done(m_a))
+            {
+                if (unsuccessful_count > 1000)
                 {
-                    CC_ASSERT(va.type == vb.type && "type mismatch");
-                    if (!va.is_void())
-                    {
-                        CC_ASSERT(mTypeMetadata.contains_key(va.type));
-                        if (auto const& test_eq = mTypeMetadata.get(va.type).check_equality)
-                            test_eq(va, vb);
-                    }
+                    RICH_LOG_ERROR(" unable to execute a test function (no precondition satisfied)");
+                    for (auto f : m_a.test_functions)
+                        RICH_LOG_ERROR("  .. could not execute '{}'", f->name);
+                    CHECK(false);
+                    break;
                 }
 
-                for (auto i = 0; i < f_a->arity(); ++i)
-                    if (f_a->arg_types_could_change[i])
+                // get function ot test
+                auto f_a = m_a.sample_suitable_test_function(rng);
+                if (f_a == nullptr)
+                    return;
+
+                // collect some values
+                auto args_a = cc::span<value*>(args_buffer_a.data(), f_a->arity());
+                auto arg_indices = cc::span<int>(index_buffer.data(), f_a->arity());
+                auto ok = m_a.try_sample_args_with_precondition(rng, f_a, args_a, arg_indices);
+                if (!ok)
+                {
+                    // execute other function
+                    if (auto ff_a = m_a.try_generate_values_for(rng, f_a, args_buffer_a, index_buffer))
                     {
-                        if (f_a->arg_types[i] == e.type_a)
-                        {
-                            CC_ASSERT(f_b->arg_types[i] == e.type_b && "type mismatch");
-                            e.test(*args_a[i], *args_b[i]);
-                        }
-                        else
-                        {
-                            CC_ASSERT(f_a->arg_types[i] == f_b->arg_types[i] && "type mismatch");
-                            CC_ASSERT(mTypeMetadata.contains_key(f_a->arg_types[i]));
-                            if (auto const& test_eq = mTypeMetadata.get(f_a->arg_types[i]).check_equality)
-                                test_eq(*args_a[i], *args_b[i]);
-                        }
+                        arg_indices = cc::span<int>(index_buffer.data(), ff_a->arity());
+                        args_a = cc::span<value*>(args_buffer_a.data(), ff_a->arity());
+                        multi_execution(rng, ff_a, args_a, arg_indices);
                     }
 
-                // reintegrate values
-                m_a.integrate_value(cc::move(va), vi);
-                m_b.integrate_value(cc::move(vb), vi);
-            };
+                    ++unsuccessful_count;
+                    swarm_drop_stuck(m_a, f_a, unsuccessful_count);
+                    continue;
+                }
+
+                // execute function on all sides
+                multi_execution(rng, f_a, args_a, arg_indices);
+                unsuccessful_count = 0;
+
+                // remove satisfied test functions
+                if (!has_budget)
+                    m_a.remove_fulfilled_test_functions(scale);
+            }
+
+            m_a.execute_deferred_invariants();
+            for (auto& m_b : em.m_impls)
+                m_b.execute_deferred_invariants();
+        }
+    }
+}
+
+bool nx::MonteCarloTest::tryExecuteExhaustive(machine_trace& failing_trace, int depth, int rng_choices)
+{
+    auto const test = nx::detail::get_current_test();
+    auto const is_debug = test->isDebug();
+    auto const num_threads = exhaustiveThreads();
+
+    auto num_sequences = 0;
+    auto failed = false;
+
+    // machines are not thread-safe, so each thread gets its own
+    cc::vector<machine_cache> thread_machines;
+    thread_machines.resize(num_threads);
+
+    // replays a chunk of sequences in parallel
+    // returns the lowest failing index or -1 (deterministic regardless of thread count)
+    auto const replay_chunk = [&](cc::span<machine_trace const> traces) -> int
+    {
+        if (is_debug)
+        {
+            for (auto const& t : traces)
+                replayTrace(t);
+            return -1;
+        }
+
+        return replayFirstFailing(thread_machines, traces);
+    };
+
+    auto const check_all = [&](equivalence const* eq, machine const& m)
+    {
+        auto constexpr chunk_size = 1024;
+        cc::vector<machine_trace> chunk;
+
+        auto const flush = [&]
+        {
+            auto fi = replay_chunk(chunk);
+            num_sequences += fi < 0 ? int(chunk.size()) : fi + 1;
+            if (fi >= 0)
+            {
+                failing_trace = chunk[fi];
+                failed = true;
+            }
+            chunk.clear();
+            return !failed;
+        };
+
+        exhaustive_enumerator e(m, eq, depth, rng_choices, get_seed());
+        e.emit = [&](machine_trace const& t)
+        {
+            chunk.push_back(t);
+            return int(chunk.size()) < chunk_size || flush();
+        };
+        e.run();
+
+        if (!failed && !chunk.empty())
+            flush();
+    };
+
+    if (mEquivalences.empty())
+        check_all(nullptr, mMachines->get(*this));
+    else
+        for (auto const& e : mEquivalences)
+        {
+            check_all(&e, mMachines->get(*this, e).m_a);
+            if (failed)
+                break;
+        }
 
-            // execute
-            auto args_buffer_a = cc::array<value*>::filled(m_a.max_arity(), nullptr);
-            auto args_buffer_b = cc::array<value*>::filled(m_a.max_arity(), nullptr);
-            auto index_buffer = cc::array<int>::filled(m_a.max_arity(), -1);
-            auto unsuccessful_count = 0;
-            while (!m_a.test_functions.empty())
-            {
-                if (unsuccessful_count > 1000)
-                {
-                    RICH_LOG_ERROR(" unable to execute a test function (no precondition satisfied)");
-                    for (auto f : m_a.test_functions)
-                        RICH_LOG_ERROR("  .. could not execute '{}'", f->name);
-                    CHECK(false);
-                    break;
-                }
+    if (!is_debug)
+        RICH_LOG("exhaustive MONTE_CARLO_TEST(\"%s\"): checked %s sequences of length <= %s (%s threads)", test->name(), num_sequences, depth, num_threads);
 
-                // get function ot test
-                auto f_a = m_a.sample_suitable_test_function(rng);
-                if (f_a == nullptr)
-                    return;
-                auto f_b = funs_b[f_a->internal_idx];
-                CC_ASSERT(f_a->arity() == f_b->arity());
+    return !failed;
+}
 
-                // collect some values
-                auto args_a = cc::span<value*>(args_buffer_a.data(), f_a->arity());
-                auto args_b = cc::span<value*>(args_buffer_b.data(), f_b->arity());
-                auto arg_indices = cc::span<int>(index_buffer.data(), f_a->arity());
-                auto ok = m_a.try_sample_args_with_precondition(rng, f_a, args_a, arg_indices);
-                if (!ok)
-                {
-                    // execute other function
-                    if (auto ff_a = m_a.try_generate_values_for(rng, f_a, args_buffer_a, index_buffer))
-                    {
-                        auto ff_b = funs_b[ff_a->internal_idx];
-                        CC_ASSERT(ff_a->arity() == ff_b->arity());
-                        arg_indices = cc::span<int>(index_buffer.data(), ff_a->arity());
-                        args_a = cc::span<value*>(args_buffer_a.data(), ff_a->arity());
-                        args_b = cc::span<value*>(args_buffer_b.data(), ff_b->arity());
+int nx::MonteCarloTest::replayThreads() const
+{
+    // session callbacks usually touch global state, so those tests are replayed sequentially
+    if (!mPreCallbacks.empty() || !mPostCallbacks.empty())
+        return 1;
 
-                        prepare_execution_b(ff_b, arg_indices, args_b);
-                        bi_execution(rng, ff_a, ff_b, args_a, args_b, arg_indices);
-                    }
+    return sessionThreads();
+}
 
-                    ++unsuccessful_count;
-                    continue;
-                }
+int nx::MonteCarloTest::exhaustiveThreads() const
+{
+    auto const test = nx::detail::get_current_test();
+    if (test->mctThreads() >= 0)
+        return replayThreads();
 
-                // build corresponding function
-                prepare_execution_b(f_b, arg_indices, args_b);
+    // exhaustive checks are opted into per test and consist of many short independent replays
+    if (test->isDebug() || !mAllowParallelSessions || !mPreCallbacks.empty() || !mPostCallbacks.empty())
+        return 1;
 
-                // execute function
-                bi_execution(rng, f_a, f_b, args_a, args_b, arg_indices);
-                unsuccessful_count = 0;
+    return nx::detail::hardware_threads();
+}
 
-                // remove satisfied test functions
-                m_a.remove_fulfilled_test_functions();
-            }
-        }
-    }
+int nx::MonteCarloTest::replayFirstFailing(cc::span<machine_cache> machines, cc::span<machine_trace const> traces, replay_checkpoints const* checkpoints)
+{
+    CC_CONTRACT(!machines.empty());
+
+    std::atomic<int> next_idx = 0;
+    std::atomic<int> failing_idx = int(traces.size());
+    nx::detail::run_parallel(int(machines.size()),
+                             [&](int thread)
+                             {
+                                 while (true)
+                                 {
+                                     auto const i = next_idx++;
+                                     if (i >= failing_idx.load())
+                                         return;
+
+                                     try
+                                     {
+                                         replayTrace(machines[thread], traces[i], false, checkpoints);
+                                     }
+                                     catch (nx::detail::assertion_failed_exception const&)
+                                     {
+                                         auto f = failing_idx.load();
+                                         while (i < f && !failing_idx.compare_exchange_weak(f, i))
+                                         {
+                                         }
+                                     }
+                                 }
+                             });
+
+    return failing_idx < int(traces.size()) ? failing_idx.load() : -1;
 }
 
 void nx::MonteCarloTest::minimizeTrace(machine_trace& trace)
 {
-    auto found_smaller = true;
+    auto const num_threads = replayThreads();
+
+    // machines are not thread-safe, so each thread gets its own
+    cc::vector<machine_cache> thread_machines;
+    thread_machines.resize(num_threads);
+
+    // candidates are replayed speculatively in batches
+    // the first failing candidate in generation order wins, so the result is the same as a sequential search
+    auto const batch_size = num_threads == 1 ? 1 : 4 * num_threads;
+    cc::vector<machine_trace> batch;
+
+    // candidates mostly share a prefix with the current trace, so they resume from snapshots of it
+    // (not possible if ops or callbacks touch global state)
+    auto const use_checkpoints = mAllowParallelSessions && mPreCallbacks.empty() && mPostCallbacks.empty();
+    replay_checkpoints checkpoints;
+    auto const record_checkpoints = [&]
+    {
+        checkpoints.start(trace);
+        try
+        {
+            replayTrace(thread_machines[0], trace, false, nullptr, &checkpoints);
+        }
+        catch (nx::detail::assertion_failed_exception const&)
+        {
+            // expected, the trace fails
+        }
+    };
+
+    auto const t_start = std::chrono::high_resolution_clock::now();
+    auto num_replays = 0;
+    auto const budget_exhausted = [&]
+    {
+        if (mMinimizationReplays >= 0 && num_replays >= mMinimizationReplays)
+            return true;
+
+        if (mMinimizationSeconds > 0)
+        {
+            auto const t_now = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration<double>(t_now - t_start).count() >= mMinimizationSeconds;
+        }
 
-    while (found_smaller) // TODO: time limit
+        return false;
+    };
+
+    auto found_smaller = true;
+    while (found_smaller)
     {
         RICH_LOG_ERROR("  .. trace complexity {}", trace.complexity());
         auto opts = trace.build_minimizer();
 
+        // recording costs a full replay, which does not pay off for short traces
+        // (older checkpoints stay valid for traces sharing their prefix)
+        if (use_checkpoints && int(trace.ops.size()) >= replay_checkpoints::min_trace_ops)
+            record_checkpoints();
+
         found_smaller = false;
-        while (!found_smaller && opts.has_options_left())
+        auto has_options_left = true;
+        while (!found_smaller && has_options_left)
         {
-            // build new trace
-            auto new_t = opts.get_next_option_for(trace);
-            CC_ASSERT(new_t.complexity() < trace.complexity() && "operation did not reduce complexity");
+            if (budget_exhausted())
+            {
+                RICH_LOG_ERROR("  .. minimization budget exhausted after %s replays, using smallest trace so far", num_replays);
+                return;
+            }
 
-            try
+            // build new traces (candidate buffers are reused across batches)
+            auto num_candidates = 0;
+            while (num_candidates < batch_size)
             {
-                // try new trace
-                replayTrace(new_t);
+                if (int(batch.size()) == num_candidates)
+                    batch.emplace_back();
+                if (!opts.next_option_for(trace, batch[num_candidates]))
+                {
+                    has_options_left = false;
+                    break;
+                }
+                CC_ASSERT(batch[num_candidates].complexity() < trace.complexity() && "operation did not reduce complexity");
+                ++num_candidates;
             }
-            catch (nx::detail::assertion_failed_exception const&)
+            if (num_candidates == 0)
+                break;
+
+            // try new traces
+            auto const candidates = cc::span<machine_trace const>(batch.data(), num_candidates);
+            auto const fi = replayFirstFailing(thread_machines, candidates, use_checkpoints ? &checkpoints : nullptr);
+            num_replays += fi < 0 ? num_candidates : fi + 1;
+
+            if (fi >= 0)
             {
                 // found a smaller failing test
-                trace = new_t;
+                trace = cc::move(batch[fi]);
                 found_smaller = true;
             }
         }
@@ -905,6 +2618,19 @@ void nx::MonteCarloTest::minimizeTrace(machine_trace& trace)
 
 bool nx::MonteCarloTest::replayTrace(machine_trace const& trace, bool print_mode)
 {
+    CC_ASSERT(mMachines != nullptr && "only valid during execute()");
+    return replayTrace(*mMachines, trace, print_mode);
+}
+
+bool nx::MonteCarloTest::replayTrace(
+    machine_cache& machines, machine_trace const& trace, bool print_mode, replay_checkpoints const* resume_from, replay_checkpoints* record_into)
+{
+    // fast path
+    if (!print_mode)
+        return replayCompiled(machines, trace, resume_from, record_into);
+
+    CC_ASSERT(!resume_from && !record_into && "printed traces are always replayed completely");
+
     if (print_mode)
         RICH_LOG_ERROR("=============== TRACE BEGIN ===============");
     CC_DEFER
@@ -941,12 +2667,13 @@ bool nx::MonteCarloTest::replayTrace(machine_trace const& trace, bool print_mode
     auto const value_to_string = [this](value const& v) -> cc::string
     {
         CC_ASSERT(!v.is_void());
-        if (!mTypeMetadata.contains_key(v.type))
+        auto const type = findTypeId(v.type);
+        if (type < 0)
             return "???";
-        auto const& f = mTypeMetadata.get(v.type).to_string;
+        auto const& f = mTypeMetadata[type].to_string;
         if (!f)
             return "???";
-        return f(v.ptr);
+        return f(v.get());
     };
 
     // print symbolic execution
@@ -974,6 +2701,8 @@ bool nx::MonteCarloTest::replayTrace(machine_trace const& trace, bool print_mode
                         s += ", ";
                     if (op.fun->arg_types_could_change[ai])
                         s += "&";
+                    else if (op.fun->arg_types_consumed[ai])
+                        s += "&&";
                     s += "v";
                     s += cc::to_string(get_var_name(op.fun->arg_types[ai], trace.arg_indices[op.args_start_idx + ai]));
                 }
@@ -1021,6 +2750,13 @@ bool nx::MonteCarloTest::replayTrace(machine_trace const& trace, bool print_mode
             {
                 if (ai > 0)
                     s += ", ";
+                if (f->arg_types_consumed[ai])
+                {
+                    s += vals[ai];
+                    s += " -> (moved)";
+                    continue;
+                }
+
                 auto vs = value_to_string(*args[ai]);
                 if (f->arg_types_could_change[ai])
                 {
@@ -1037,7 +2773,7 @@ bool nx::MonteCarloTest::replayTrace(machine_trace const& trace, bool print_mode
             }
             s += ")";
         }
-        if (f->return_type != typeid(void))
+        if (!v.is_void()) // also void if one of the args was returned
         {
             s += " -> ";
             s += value_to_string(v);
@@ -1048,8 +2784,8 @@ bool nx::MonteCarloTest::replayTrace(machine_trace const& trace, bool print_mode
     // normal mode: no equivalence checking
     if (trace.equiv == nullptr)
     {
-        // build machine
-        auto m = machine::build(*this, mFunctions);
+        // reuse machine
+        auto& m = machines.get(*this);
 
         // execute
         auto args_buffer = cc::array<value*>::filled(m.max_arity(), nullptr);
@@ -1063,131 +2799,600 @@ bool nx::MonteCarloTest::replayTrace(machine_trace const& trace, bool print_mode
             // collect arguments
             auto args = cc::span<value*>(args_buffer.data(), f->arity());
             for (auto i = 0; i < f->arity(); ++i)
-                args[i] = &m.values[f->arg_types[i]].vars[trace.arg_indices[op.args_start_idx + i]];
+                args[i] = &m.values[f->arg_type_ids[i]].vars[trace.arg_indices[op.args_start_idx + i]];
+
+            if (!machine::are_valid_args(f, args))
+                return false; // reads an empty slot, i.e. invalid trace
 
             // print trace
             if (print_mode)
                 print_inputs(f, args, arg_string_buffer);
 
-            // check precondition
-            if (f->precondition && !f->precondition(args))
-                return false; // precondition violated, i.e. invalid trace
+            // check precondition
+            if (f->precondition && !f->precondition(args))
+                return false; // precondition violated, i.e. invalid trace
+
+            // execute function (no invariants)
+            auto v = m.execute(f, args, false, op.seed);
+
+            // print outputs
+            if (print_mode)
+                print_outputs("  ", f, v, args, arg_string_buffer);
+
+            // check invariants
+            m.execute_invariants_for(f, v, args);
+
+            // reintegrate values
+            m.integrate_value(cc::move(v), f->return_type_id, op.return_value_idx);
+        }
+    }
+    else // equivalence checker
+    {
+        auto const& e = *trace.equiv;
+
+        // reuse machines
+        auto& em = machines.get(*this, e);
+        auto const& funs_a = em.funs_a;
+        auto& m_a = em.m_a;
+        auto const num_impls = int(em.m_impls.size());
+        for (auto const& m_b : em.m_impls)
+            REQUIRE(m_a.max_arity() == m_b.max_arity());
+
+        // execute
+        auto args_buffer_a = cc::array<value*>::filled(m_a.max_arity(), nullptr);
+        auto arg_string_buffer_a = cc::array<cc::string>::defaulted(m_a.max_arity());
+        auto args_buffers_b = cc::vector<cc::array<value*>>();
+        auto arg_string_buffers_b = cc::vector<cc::array<cc::string>>();
+        auto results_b = cc::vector<value>();
+        for (auto k = 0; k < num_impls; ++k)
+        {
+            args_buffers_b.push_back(cc::array<value*>::filled(m_a.max_arity(), nullptr));
+            arg_string_buffers_b.push_back(cc::array<cc::string>::defaulted(m_a.max_arity()));
+            results_b.emplace_back();
+        }
+
+        // reference is printed as "A:", implementations as "B:", "C:", ...
+        auto const impl_prefix = [](int k)
+        {
+            cc::string p;
+            p += char('B' + k % 25);
+            p += ':';
+            return p;
+        };
+
+        for (auto const& op : trace.ops)
+        {
+            auto f_a = funs_a[op.function_idx];
+            auto const f_b = [&](int k) { return em.funs_impls[k][op.function_idx]; };
+            auto const args_b = [&](int k) { return cc::span<value*>(args_buffers_b[k].data(), f_b(k)->arity()); };
+
+            // collect arguments
+            auto args_a = cc::span<value*>(args_buffer_a.data(), f_a->arity());
+            for (auto i = 0; i < f_a->arity(); ++i)
+            {
+                auto const ai = trace.arg_indices[op.args_start_idx + i];
+                args_a[i] = &m_a.values[f_a->arg_type_ids[i]].vars[ai];
+                for (auto k = 0; k < num_impls; ++k)
+                    args_b(k)[i] = &em.m_impls[k].values[f_b(k)->arg_type_ids[i]].vars[ai];
+            }
+
+            if (!machine::are_valid_args(f_a, args_a))
+                return false; // reads an empty slot, i.e. invalid trace
+            for (auto k = 0; k < num_impls; ++k)
+                if (!machine::are_valid_args(f_b(k), args_b(k)))
+                    return false;
+
+            // print trace
+            if (print_mode)
+            {
+                print_inputs(f_a, args_a, arg_string_buffer_a);
+                for (auto k = 0; k < num_impls; ++k)
+                    print_inputs(f_b(k), args_b(k), arg_string_buffers_b[k]);
+            }
+
+            // check precondition
+            if (f_a->precondition && !f_a->precondition(args_a))
+                return false; // precondition violated, i.e. invalid trace
+            for (auto k = 0; k < num_impls; ++k)
+                if (f_b(k)->precondition && !f_b(k)->precondition(args_b(k)))
+                    return false; // precondition violated, i.e. invalid trace
+
+            // execute function
+            auto va = m_a.execute(f_a, args_a, false, op.seed);
+            for (auto k = 0; k < num_impls; ++k)
+                results_b[k] = em.m_impls[k].execute(f_b(k), args_b(k), false, op.seed);
+
+            // print outputs
+            if (print_mode)
+            {
+                print_outputs("A:", f_a, va, args_a, arg_string_buffer_a);
+                for (auto k = 0; k < num_impls; ++k)
+                    print_outputs(impl_prefix(k), f_b(k), results_b[k], args_b(k), arg_string_buffers_b[k]);
+            }
+
+            // check invariants
+            m_a.execute_invariants_for(f_a, va, args_a);
+            for (auto k = 0; k < num_impls; ++k)
+                em.m_impls[k].execute_invariants_for(f_b(k), results_b[k], args_b(k));
+
+            // test equivalence
+            for (auto k = 0; k < num_impls; ++k)
+                checkEquivalentResults(e, k, f_a, f_b(k), va, results_b[k], args_a, args_b(k));
+
+            // add values (not if any side returned one of its args, as while sampling)
+            auto vi = op.return_value_idx;
+            if (machine::has_returned_arg(va, results_b))
+                vi = -1;
+            m_a.integrate_value(cc::move(va), f_a->return_type_id, vi);
+            for (auto k = 0; k < num_impls; ++k)
+                em.m_impls[k].integrate_value(cc::move(results_b[k]), f_b(k)->return_type_id, vi);
+        }
+    }
+
+    return true;
+}
+
+void nx::MonteCarloTest::checkEquivalentResults(equivalence const& e,
+                                                 int impl,
+                                                 function const* f_a,
+                                                 function const* f_b,
+                                                 value const& va,
+                                                 value const& vb,
+                                                 cc::span<value*> args_a,
+                                                 cc::span<value*> args_b) const
+{
+    auto const& eb = e.impls[impl];
+
+    // results
+    // a side that returned one of its args is compared via that arg (see function::may_return_arg)
+    // if both sides did, the args are compared below
+    if (va.get_returned_arg() == nullptr || vb.get_returned_arg() == nullptr)
+    {
+        auto const& ra = va.get_returned_arg() ? *va.get_returned_arg() : va;
+        auto const& rb = vb.get_returned_arg() ? *vb.get_returned_arg() : vb;
+        if (ra.type == e.type_a)
+        {
+            CC_ASSERT(rb.type == eb.type && "type mismatch");
+            eb.test(ra, rb);
+        }
+        else
+        {
+            CC_ASSERT(ra.type == rb.type && "type mismatch");
+            if (!ra.is_void())
+            {
+                if (auto const& test_eq = mTypeMetadata[f_a->return_type_id].check_equality)
+                    test_eq(ra, rb);
+            }
+        }
+    }
+
+    for (auto i = 0; i < f_a->arity(); ++i)
+        if (f_a->arg_types_could_change[i])
+        {
+            if (f_a->arg_types[i] == e.type_a)
+            {
+                CC_ASSERT(f_b->arg_types[i] == eb.type && "type mismatch");
+                eb.test(*args_a[i], *args_b[i]);
+            }
+            else
+            {
+                CC_ASSERT(f_a->arg_types[i] == f_b->arg_types[i] && "type mismatch");
+                if (auto const& test_eq = mTypeMetadata[f_a->arg_type_ids[i]].check_equality)
+                    test_eq(*args_a[i], *args_b[i]);
+            }
+        }
+}
+
+bool nx::MonteCarloTest::replayCompiled(machine_cache& machines, machine_trace const& trace, replay_checkpoints const* resume_from, replay_checkpoints* record_into)
+{
+    // pre callbacks
+    for (auto& f : mPreCallbacks)
+        f();
+
+    // post callbacks
+    CC_DEFER
+    {
+        for (auto& f : mPostCallbacks)
+            f();
+    };
+
+    auto const checkpoint = resume_from ? resume_from->find(trace) : nullptr;
+    auto const first_op = checkpoint ? checkpoint->num_ops : 0;
+
+    auto& ct = machines.compiled;
+
+    // normal mode: no equivalence checking
+    if (trace.equiv == nullptr)
+    {
+        auto& m = machines.get(*this);
+        if (checkpoint)
+            m.load_values(checkpoint->a);
+
+        ct.compile(trace, first_op, {}, {});
+        ct.bind(m, ct.bound_a, -1);
+
+        for (auto ii = 0; ii < int(ct.instructions.size()); ++ii)
+        {
+            if (record_into)
+                record_into->record(first_op + ii, m);
+
+            auto const& in = ct.instructions[ii];
+            auto const args = cc::span<value*>(ct.bound_a.args.data() + in.args_start, in.fun_a->arity());
+
+            if (ct.check_args && !machine::are_valid_args(in.fun_a, args))
+                return false; // reads an empty slot, i.e. invalid trace
+            if (in.has_precondition && !in.fun_a->precondition(args))
+                return false; // precondition violated, i.e. invalid trace
+
+            auto v = m.execute(in.fun_a, args, false, in.seed);
+            m.execute_invariants_for(in.fun_a, v, args);
+
+            // void if the op returned one of its args (see function::may_return_arg)
+            if (auto slot = ct.bound_a.returns[ii]; slot && !v.is_void())
+                *slot = cc::move(v);
+        }
+    }
+    else // equivalence checker
+    {
+        auto const& e = *trace.equiv;
+
+        auto& em = machines.get(*this, e);
+        auto& m_a = em.m_a;
+        auto const num_impls = int(em.m_impls.size());
+        if (checkpoint)
+        {
+            m_a.load_values(checkpoint->a);
+            for (auto k = 0; k < num_impls; ++k)
+                em.m_impls[k].load_values(checkpoint->impls[k]);
+        }
+
+        ct.compile(trace, first_op, em.funs_a, em.funs_impls);
+        ct.bind(m_a, ct.bound_a, -1);
+        for (auto k = 0; k < num_impls; ++k)
+            ct.bind(em.m_impls[k], ct.bound_impls[k], k);
+
+        // results that are not stored in a slot must not outlive the session arena
+        auto& results_b = ct.results_impls;
+        results_b.resize(num_impls);
+        CC_DEFER
+        {
+            for (auto& r : results_b)
+                r = value();
+        };
+
+        for (auto ii = 0; ii < int(ct.instructions.size()); ++ii)
+        {
+            if (record_into)
+                record_into->record(first_op + ii, m_a, em.m_impls);
+
+            auto const& in = ct.instructions[ii];
+            auto const args_a = cc::span<value*>(ct.bound_a.args.data() + in.args_start, in.fun_a->arity());
+            auto const args_b = [&](int k) { return cc::span<value*>(ct.bound_impls[k].args.data() + in.args_start, in.fun_a->arity()); };
+
+            if (ct.check_args)
+            {
+                if (!machine::are_valid_args(in.fun_a, args_a))
+                    return false; // reads an empty slot, i.e. invalid trace
+                for (auto k = 0; k < num_impls; ++k)
+                    if (!machine::are_valid_args(ct.fun(ii, k), args_b(k)))
+                        return false;
+            }
+            if (in.has_precondition)
+            {
+                if (in.fun_a->precondition && !in.fun_a->precondition(args_a))
+                    return false; // precondition violated, i.e. invalid trace
+                for (auto k = 0; k < num_impls; ++k)
+                    if (!ct.fun(ii, k)->precondition(args_b(k)))
+                        return false;
+            }
+
+            auto va = m_a.execute(in.fun_a, args_a, false, in.seed);
+            for (auto k = 0; k < num_impls; ++k)
+                results_b[k] = em.m_impls[k].execute(ct.fun(ii, k), args_b(k), false, in.seed);
+
+            m_a.execute_invariants_for(in.fun_a, va, args_a);
+            for (auto k = 0; k < num_impls; ++k)
+                em.m_impls[k].execute_invariants_for(ct.fun(ii, k), results_b[k], args_b(k));
+
+            for (auto k = 0; k < num_impls; ++k)
+                checkEquivalentResults(e, k, in.fun_a, ct.fun(ii, k), va, results_b[k], args_a, args_b(k));
+
+            // not if any side returned one of its args, as while sampling
+            if (machine::has_returned_arg(va, results_b))
+                continue;
+
+            if (auto slot = ct.bound_a.returns[ii])
+                *slot = cc::move(va);
+            for (auto k = 0; k < num_impls; ++k)
+                if (auto slot = ct.bound_impls[k].returns[ii])
+                    *slot = cc::move(results_b[k]);
+        }
+    }
+
+    return true;
+}
+
+void nx::MonteCarloTest::benchmarkTrace(machine_trace const& trace)
+{
+    static constexpr int repetitions = 5; // each for throughput (untimed ops) and latencies (timed ops)
+
+    struct op_stats
+    {
+        long long calls = 0;
+        double total_ms = 0;
+        double min_ms = 0;
+        double max_ms = 0;
+    };
+
+    auto const test = nx::detail::get_current_test();
+    auto& machines = *mMachines;
+    auto& ct = machines.compiled;
+
+    auto const em = trace.equiv ? &machines.get(*this, *trace.equiv) : nullptr;
+    auto const num_impls = em ? int(em->m_impls.size()) : 0;
+    if (em)
+        ct.compile(trace, 0, em->funs_a, em->funs_impls);
+    else
+        ct.compile(trace, 0, {}, {});
+
+    RICH_LOG("MCT benchmark of '{}': {} ops, best of {} runs", test->name(), ct.instructions.size(), repetitions);
+
+    // reference (or normal trace) first, then each implementation of the equivalence
+    for (auto side = -1; side < num_impls; ++side)
+    {
+        auto ops = cc::vector<op_stats>::defaulted(mFunctions.size());
+        auto best_ms = 0.0;
+        auto sum_ms = 0.0;
+
+        for (auto rep = 0; rep < 2 * repetitions; ++rep)
+        {
+            auto const timed = rep >= repetitions;
+
+            for (auto& f : mPreCallbacks)
+                f();
+            CC_DEFER
+            {
+                for (auto& f : mPostCallbacks)
+                    f();
+            };
+
+            // fresh machine
+            machine* m = nullptr;
+            if (em)
+            {
+                auto& ms = machines.get(*this, *trace.equiv);
+                m = side < 0 ? &ms.m_a : &ms.m_impls[side];
+            }
+            else
+                m = &machines.get(*this);
+
+            auto& b = side < 0 ? ct.bound_a : ct.bound_impls[side];
+            ct.bind(*m, b, side);
+
+            auto const t0 = profile_clock::now();
+            for (auto ii = 0; ii < int(ct.instructions.size()); ++ii)
+            {
+                auto const& in = ct.instructions[ii];
+                auto const f = ct.fun(ii, side);
+                auto const args = cc::span<value*>(b.args.data() + in.args_start, f->arity());
+
+                // the first run validates the workload (before any op reads a slot that was never written)
+                if (rep == 0 && !machine::are_valid_args(f, args))
+                {
+                    RICH_LOG_ERROR("benchmark trace passes an empty value to '{}' at op {} (was it recorded for another test?)", f->name, ii);
+                    CHECK(false);
+                    return;
+                }
+                if (rep == 0 && f->precondition && !f->precondition(args))
+                {
+                    RICH_LOG_ERROR("benchmark trace violates the precondition of '{}' at op {} (was it recorded for another test?)", f->name, ii);
+                    CHECK(false);
+                    return;
+                }
+
+                value v;
+                if (timed)
+                {
+                    auto const t_op = profile_clock::now();
+                    v = m->execute(f, args, false, in.seed);
+                    auto const ms = elapsed_ms(t_op);
+
+                    auto& os = ops[f->idx];
+                    os.min_ms = os.calls == 0 ? ms : tg::min(os.min_ms, ms);
+                    os.max_ms = tg::max(os.max_ms, ms);
+                    os.total_ms += ms;
+                    os.calls++;
+                }
+                else
+                    v = m->execute(f, args, false, in.seed);
 
-            // execute function (no invariants)
-            auto v = m.execute(f, args, false, op.seed);
+                if (auto slot = b.returns[ii]; slot && !v.is_void()) // void if one of the args was returned
+                    *slot = cc::move(v);
+            }
+            auto const total_ms = elapsed_ms(t0);
 
-            // print outputs
-            if (print_mode)
-                print_outputs("  ", f, v, args, arg_string_buffer);
+            if (!timed)
+            {
+                best_ms = rep == 0 ? total_ms : tg::min(best_ms, total_ms);
+                sum_ms += total_ms;
+            }
+        }
 
-            // check invariants
-            m.execute_invariants_for(f, v, args);
+        if (em)
+            RICH_LOG("  {} {}", side < 0 ? "reference" : "implementation",
+                     cc::demangle(side < 0 ? trace.equiv->type_a.name() : trace.equiv->impls[side].type.name()));
+        auto const ops_per_sec = best_ms > 0 ? ct.instructions.size() / (best_ms / 1000) : 0.0;
+        RICH_LOG("  total: best %.3f ms, mean %.3f ms, %.0f ops/s", best_ms, sum_ms / repetitions, ops_per_sec);
+        RICH_LOG("  %<24s %10s %10s %10s %10s %10s", "op", "calls", "total ms", "mean us", "min us", "max us");
+        for (auto i = 0; i < int(ops.size()); ++i)
+        {
+            auto const& os = ops[i];
+            if (os.calls == 0)
+                continue;
 
-            // reintegrate values
-            m.integrate_value(cc::move(v), op.return_value_idx);
+            RICH_LOG("  %<24s %10s %10.3f %10.3f %10.3f %10.3f", mFunctions[i].name, os.calls / repetitions, os.total_ms / repetitions,
+                     os.total_ms * 1000 / os.calls, os.min_ms * 1000, os.max_ms * 1000);
         }
     }
-    else // equivalence checker
-    {
-        auto const& e = *trace.equiv;
+}
 
-        // prepare machines
-        cc::vector<function*> funs_a;
-        cc::vector<function*> funs_b;
-        auto machines = machine::build_equivalence_checker(*this, e, funs_a, funs_b);
-        auto& m_a = machines.first;
-        auto& m_b = machines.second;
-        REQUIRE(m_a.max_arity() == m_b.max_arity());
-        CC_ASSERT(funs_a.size() == funs_b.size());
+void nx::MonteCarloTest::reportCoverage(cc::span<cc::set<uint64_t> const> visited_states) const
+{
+    auto total = 0;
+    for (auto const& states : visited_states)
+        total += int(states.size());
+
+    RICH_LOG("MCT state coverage of '{}': {} distinct states", nx::detail::get_current_test()->name(), total);
+    for (auto t = 0; t < int(visited_states.size()); ++t)
+        if (mTypeMetadata[t].hash)
+            RICH_LOG("  %<24s %10s states", cc::demangle(mTypes[t].name()), visited_states[t].size());
+}
 
-        // execute
-        auto args_buffer_a = cc::array<value*>::filled(m_a.max_arity(), nullptr);
-        auto args_buffer_b = cc::array<value*>::filled(m_a.max_arity(), nullptr);
-        auto arg_string_buffer_a = cc::array<cc::string>::defaulted(m_a.max_arity());
-        auto arg_string_buffer_b = cc::array<cc::string>::defaulted(m_a.max_arity());
-        for (auto const& op : trace.ops)
+void nx::MonteCarloTest::reportSpeedups(speedup_stats const& speedups) const
+{
+    RICH_LOG("MCT speedups of '{}' (reference time / implementation time, with 95 percent confidence intervals)", nx::detail::get_current_test()->name());
+    for (auto ei = 0; ei < int(mEquivalences.size()); ++ei)
+    {
+        auto const& e = mEquivalences[ei];
+        for (auto k = 0; k < int(e.impls.size()); ++k)
         {
-            auto f_a = funs_a[op.function_idx];
-            auto f_b = funs_b[op.function_idx];
+            auto const& is = speedups.equivalences[ei][k];
+            if (is.total.n == 0)
+                continue;
 
-            // collect arguments
-            auto args_a = cc::span<value*>(args_buffer_a.data(), f_a->arity());
-            auto args_b = cc::span<value*>(args_buffer_b.data(), f_b->arity());
-            for (auto i = 0; i < f_a->arity(); ++i)
+            double speedup, lo, hi;
+            is.total.total_speedup(speedup, lo, hi);
+            RICH_LOG("  %s vs. reference %s: %.3fx total [%.3f, %.3f] over %s ops", cc::demangle(e.impls[k].type.name()),
+                     cc::demangle(e.type_a.name()), speedup, lo, hi, is.total.n);
+            RICH_LOG("    %<24s %10s %10s %10s %10s %10s %10s", "op", "calls", "ref us", "impl us", "speedup", "lower", "upper");
+            for (auto i = 0; i < int(is.ops.size()); ++i)
             {
-                args_a[i] = &m_a.values[f_a->arg_types[i]].vars[trace.arg_indices[op.args_start_idx + i]];
-                args_b[i] = &m_b.values[f_b->arg_types[i]].vars[trace.arg_indices[op.args_start_idx + i]];
-            }
+                auto const& pt = is.ops[i];
+                if (pt.n == 0)
+                    continue;
 
-            // print trace
-            if (print_mode)
-            {
-                print_inputs(f_a, args_a, arg_string_buffer_a);
-                print_inputs(f_b, args_b, arg_string_buffer_b);
+                pt.geomean_speedup(speedup, lo, hi);
+                RICH_LOG("    %<24s %10s %10.3f %10.3f %10.3f %10.3f %10.3f", mFunctions[i].name, pt.n, pt.sum_a * 1000 / pt.n,
+                         pt.sum_b * 1000 / pt.n, speedup, lo, hi);
             }
+        }
+    }
+}
 
-            // check precondition
-            if (f_a->precondition && !f_a->precondition(args_a))
-                return false; // precondition violated, i.e. invalid trace
-            if (f_b->precondition && !f_b->precondition(args_b))
-                return false; // precondition violated, i.e. invalid trace
+void nx::MonteCarloTest::checkSpeedups(speedup_stats const& speedups, double max_slowdown) const
+{
+    auto const min_speedup = 1 / max_slowdown;
+    for (auto ei = 0; ei < int(mEquivalences.size()); ++ei)
+    {
+        auto const& e = mEquivalences[ei];
+        for (auto k = 0; k < int(e.impls.size()); ++k)
+        {
+            auto const& is = speedups.equivalences[ei][k];
+            for (auto i = 0; i < int(is.ops.size()); ++i)
+            {
+                // only ops that are slower with confidence, i.e. the whole interval lies below the threshold
+                auto const& pt = is.ops[i];
+                if (pt.n < 2)
+                    continue;
 
-            // execute function
-            auto va = m_a.execute(f_a, args_a, false, op.seed);
-            auto vb = m_b.execute(f_b, args_b, false, op.seed);
+                double speedup, lo, hi;
+                pt.geomean_speedup(speedup, lo, hi);
+                if (hi >= min_speedup)
+                    continue;
 
-            // print outputs
-            if (print_mode)
-            {
-                print_outputs("A:", f_a, va, args_a, arg_string_buffer_a);
-                print_outputs("B:", f_b, vb, args_b, arg_string_buffer_b);
+                RICH_LOG_ERROR("op '{}' of {} is slower than the reference {}: speedup {} in [{}, {}] (allowed slowdown: {}x)", mFunctions[i].name,
+                               cc::demangle(e.impls[k].type.name()), cc::demangle(e.type_a.name()), speedup, lo, hi, max_slowdown);
+                CHECK(hi >= min_speedup);
             }
+        }
+    }
+}
 
-            // check invariants
-            m_a.execute_invariants_for(f_a, va, args_a);
-            m_b.execute_invariants_for(f_b, vb, args_b);
+void nx::MonteCarloTest::reportProfile(profile_stats const& profile) const
+{
+    auto const json_escape = [](cc::string_view str)
+    {
+        cc::string r;
+        for (auto c : str)
+        {
+            if (c == '"' || c == '\\')
+                r += '\\';
+            if (uint8_t(c) >= 0x20)
+                r += c;
+        }
+        return r;
+    };
 
-            // test equivalence
-            if (va.type == e.type_a)
-            {
-                CC_ASSERT(vb.type == e.type_b && "type mismatch");
-                e.test(va, vb);
-            }
-            else
-            {
-                CC_ASSERT(va.type == vb.type && "type mismatch");
-                if (!va.is_void())
-                {
-                    CC_ASSERT(mTypeMetadata.contains_key(va.type));
-                    if (auto const& test_eq = mTypeMetadata.get(va.type).check_equality)
-                        test_eq(va, vb);
-                }
-            }
+    // ops sorted by total time
+    cc::vector<int> order;
+    for (auto i = 0; i < int(mFunctions.size()); ++i)
+        if (profile.functions[i].executions > 0 || profile.functions[i].precondition_checks > 0)
+            order.push_back(i);
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return profile.functions[a].total_ms > profile.functions[b].total_ms; });
+
+    RICH_LOG("MCT profile of '{}' ({} sessions)", nx::detail::get_current_test()->name(), profile.sessions);
+    RICH_LOG("  %<24s %10s %10s %10s %10s %10s %9s %10s", "op", "calls", "total ms", "mean us", "max us", "precond", "reject %", "fallbacks");
+
+    // NOTE: json is built by concatenation, braces would be format placeholders
+    cc::string json;
+    json += "{\"sessions\":";
+    json += cc::to_string(profile.sessions);
+    json += ",\"functions\":[";
+    for (auto oi = 0; oi < int(order.size()); ++oi)
+    {
+        auto const& f = mFunctions[order[oi]];
+        auto const& fs = profile.functions[order[oi]];
+        auto const mean_us = fs.executions > 0 ? fs.total_ms * 1000 / fs.executions : 0.0;
+        auto const reject_rate = fs.precondition_checks > 0 ? double(fs.precondition_rejections) / fs.precondition_checks : 0.0;
 
-            for (auto i = 0; i < f_a->arity(); ++i)
-                if (f_a->arg_types_could_change[i])
-                {
-                    if (f_a->arg_types[i] == e.type_a)
-                    {
-                        CC_ASSERT(f_b->arg_types[i] == e.type_b && "type mismatch");
-                        e.test(*args_a[i], *args_b[i]);
-                    }
-                    else
-                    {
-                        CC_ASSERT(f_a->arg_types[i] == f_b->arg_types[i] && "type mismatch");
-                        CC_ASSERT(mTypeMetadata.contains_key(f_a->arg_types[i]));
-                        if (auto const& test_eq = mTypeMetadata.get(f_a->arg_types[i]).check_equality)
-                            test_eq(*args_a[i], *args_b[i]);
-                    }
-                }
+        auto name = f.name;
+        if (f.is_invariant)
+            name += " [INVARIANT]";
+        RICH_LOG("  %<24s %10s %10.3f %10.3f %10.3f %10s %9.1f %10s", name, fs.executions, fs.total_ms, mean_us, fs.max_ms * 1000,
+                 fs.precondition_checks, reject_rate * 100, fs.fallbacks);
+
+        json += oi > 0 ? ",{" : "{";
+        json += "\"name\":\"" + json_escape(f.name) + "\"";
+        json += f.is_invariant ? ",\"invariant\":true" : ",\"invariant\":false";
+        json += ",\"executions\":" + cc::to_string(fs.executions);
+        json += cc::format(",\"total_ms\":%.6f,\"mean_us\":%.6f,\"max_us\":%.6f", fs.total_ms, mean_us, fs.max_ms * 1000);
+        json += ",\"precondition_checks\":" + cc::to_string(fs.precondition_checks);
+        json += cc::format(",\"precondition_rejection_rate\":%.6f", reject_rate);
+        json += ",\"fallbacks\":" + cc::to_string(fs.fallbacks);
+        json += "}";
+    }
+
+    RICH_LOG("  %<24s %10s  mean pool size per %s ops", "type", "max pool", profile_stats::ops_per_bucket);
+    json += "],\"types\":[";
+    auto first_type = true;
+    for (auto t = 0; t < int(mTypes.size()); ++t)
+    {
+        auto const& ts = profile.types[t];
+        if (ts.size_sum.empty())
+            continue;
 
-            // add values
-            m_a.integrate_value(cc::move(va), op.return_value_idx);
-            m_b.integrate_value(cc::move(vb), op.return_value_idx);
+        cc::string sizes;
+        cc::string json_sizes;
+        for (auto b = 0; b < int(ts.size_sum.size()); ++b)
+        {
+            auto const mean = ts.size_cnt[b] > 0 ? ts.size_sum[b] / ts.size_cnt[b] : 0.0;
+            cc::format_to(sizes, " %.1f", mean);
+            cc::format_to(json_sizes, "%s%.3f", b > 0 ? "," : "", mean);
         }
+
+        auto const type_name = cc::demangle(mTypes[t].name());
+        RICH_LOG("  %<24s %10s %s", type_name, ts.max_size, sizes);
+
+        json += first_type ? "{" : ",{";
+        first_type = false;
+        json += "\"name\":\"" + json_escape(type_name) + "\"";
+        json += ",\"max_size\":" + cc::to_string(ts.max_size);
+        json += ",\"ops_per_bucket\":" + cc::to_string(profile_stats::ops_per_bucket);
+        json += ",\"mean_size\":[" + json_sizes + "]}";
     }
+    json += "]}";
 
-    return true;
+    nx::detail::get_current_test()->setMctProfileJson(cc::move(json));
 }
 
 void nx::MonteCarloTest::printSetup()
@@ -1216,6 +3421,9 @@ void nx::MonteCarloTest::machine_trace::start(equivalence const* eq)
 {
     equiv = eq;
 
+    is_swarm = false;
+    swarm_disabled.clear();
+
     ops.clear();
     ops.reserve(500);
 
@@ -1223,10 +3431,56 @@ void nx::MonteCarloTest::machine_trace::start(equivalence const* eq)
     arg_indices.reserve(500);
 }
 
-nx::minimize_options<nx::MonteCarloTest::machine_trace> nx::MonteCarloTest::machine_trace::build_minimizer() const
+cc::vector<bool> nx::MonteCarloTest::machine_trace::backward_slice(int op_idx) const
 {
-    nx::minimize_options<nx::MonteCarloTest::machine_trace> min;
+    CC_CONTRACT(0 <= op_idx && op_idx < int(ops.size()));
+
+    auto in_slice = cc::vector<bool>::defaulted(ops.size());
+
+    // live[type][var] is true if the value currently in that var is needed by the slice
+    cc::vector<cc::vector<bool>> live;
+    auto const is_live = [&live](int type, int idx) { return type < int(live.size()) && idx < int(live[type].size()) && live[type][idx]; };
+    auto const set_live = [&live](int type, int idx, bool v)
+    {
+        if (int(live.size()) <= type)
+            live.resize(type + 1);
+        if (int(live[type].size()) <= idx)
+            live[type].resize(idx + 1);
+        live[type][idx] = v;
+    };
+
+    for (auto i = op_idx; i >= 0; --i)
+    {
+        auto const& op = ops[i];
+        auto const& f = *op.fun;
+
+        // an op is needed if it defines or mutates a live value
+        auto needed = i == op_idx;
+        if (op.return_value_idx != -1 && is_live(f.return_type_id, op.return_value_idx))
+            needed = true;
+        for (auto ai = 0; ai < f.arity() && !needed; ++ai)
+            if ((f.arg_types_could_change[ai] || f.arg_types_consumed[ai]) && is_live(f.arg_type_ids[ai], arg_indices[op.args_start_idx + ai]))
+                needed = true;
+
+        if (!needed)
+            continue;
+
+        in_slice[i] = true;
+
+        // the return value is (re)defined here, so earlier values in that var are irrelevant
+        if (op.return_value_idx != -1)
+            set_live(f.return_type_id, op.return_value_idx, false);
+
+        // all args are read (mutated args are read and written)
+        for (auto ai = 0; ai < f.arity(); ++ai)
+            set_live(f.arg_type_ids[ai], arg_indices[op.args_start_idx + ai], true);
+    }
+
+    return in_slice;
+}
 
+nx::minimize_options<nx::MonteCarloTest::machine_trace> nx::MonteCarloTest::machine_trace::build_minimizer() const
+{
     struct var_info
     {
         bool has_reads = false;
@@ -1264,7 +3518,186 @@ nx::minimize_options<nx::MonteCarloTest::machine_trace> nx::MonteCarloTest::mach
         }
     };
 
-    cc::map<std::type_index, varset_info> varsets;
+    // enumerates candidates in order of expected payoff
+    // only the analysis is done up front, each candidate is built when pulled
+    struct candidate_generator
+    {
+        enum class stage
+        {
+            slice,
+            exponential_disable,
+            disable_single,
+            rename_vars,
+            change_args,
+            done
+        };
+
+        cc::vector<varset_info> varsets; // per dense type id
+        cc::vector<bool> in_slice;
+        cc::vector<bool> can_disable_fun;
+        bool try_slice = false;
+        bool try_exponential_disable = false;
+        size_t seed = 0;
+
+        // cursor (meaning depends on the stage)
+        stage curr = stage::slice;
+        int i = 0;
+        int j = -1;
+        int k = 0;
+
+        varset_info& varset(int type)
+        {
+            CC_ASSERT(type >= 0);
+            if (int(varsets.size()) <= type)
+                varsets.resize(type + 1);
+            return varsets[type];
+        }
+
+        bool operator()(machine_trace const& t, machine_trace& out)
+        {
+            auto const num_ops = int(t.ops.size());
+
+            while (true)
+            {
+                switch (curr)
+                {
+                // try the backward slice of the failing (last) op first
+                // ops that neither produce nor mutate a value it (transitively) depends on are removed in a single step
+                case stage::slice:
+                    curr = stage::exponential_disable;
+                    if (try_slice)
+                    {
+                        out = t;
+                        out.ops.clear();
+                        for (auto oi = 0; oi < num_ops; ++oi)
+                            if (in_slice[oi])
+                                out.ops.push_back(t.ops[oi]);
+                        return true;
+                    }
+                    break;
+
+                // exponential disable
+                case stage::exponential_disable:
+                    curr = stage::disable_single;
+                    if (try_exponential_disable)
+                    {
+                        tg::rng rng;
+                        rng.seed(seed);
+                        out = t;
+                        out.ops.clear();
+                        for (auto oi = 0; oi < num_ops; ++oi)
+                            if (!can_disable_fun[oi] || tg::uniform<bool>(rng))
+                                out.ops.push_back(t.ops[oi]);
+                        out.ops.pop_back();
+                        return true;
+                    }
+                    break;
+
+                // disable single functions (i: op)
+                case stage::disable_single:
+                    while (i < num_ops && !can_disable_fun[i])
+                        ++i;
+                    if (i < num_ops)
+                    {
+                        out = t;
+                        for (auto oi = i + 1; oi < num_ops; ++oi)
+                            out.ops[oi - 1] = out.ops[oi];
+                        out.ops.pop_back();
+                        ++i;
+                        return true;
+                    }
+                    curr = stage::rename_vars;
+                    i = 0;
+                    j = -1;
+                    k = 0;
+                    break;
+
+                // try to rename complete vars (i: type, j: from var, k: to var)
+                case stage::rename_vars:
+                    while (i < int(varsets.size()))
+                    {
+                        auto const& vars = varsets[i].vars;
+                        if (j < 0) // first var of this type
+                        {
+                            j = int(vars.size()) - 1;
+                            k = 0;
+                        }
+                        if (j <= 0)
+                        {
+                            ++i;
+                            j = -1;
+                            continue;
+                        }
+                        if (k >= j || (!vars[j].has_reads && !vars[j].has_writes)) // done or unused var slot
+                        {
+                            --j;
+                            k = 0;
+                            continue;
+                        }
+
+                        out = t;
+                        for (auto& op : out.ops)
+                        {
+                            // rename return val
+                            if (op.fun->return_type_id == i && op.return_value_idx == j)
+                                op.return_value_idx = k;
+
+                            // rename args
+                            for (auto ai = 0; ai < op.fun->arity(); ++ai)
+                                if (op.fun->arg_type_ids[ai] == i && out.arg_indices[op.args_start_idx + ai] == j)
+                                    out.arg_indices[op.args_start_idx + ai] = k;
+                        }
+                        ++k;
+                        return true;
+                    }
+                    curr = stage::change_args;
+                    i = 0;
+                    j = 0;
+                    k = 0;
+                    break;
+
+                // try to use different args (i: op, k: arg, j: new var)
+                case stage::change_args:
+                    while (i < num_ops)
+                    {
+                        auto const& op = t.ops[i];
+                        if (k >= op.fun->arity())
+                        {
+                            ++i;
+                            k = 0;
+                            j = 0;
+                            continue;
+                        }
+
+                        auto const vi = t.arg_indices[op.args_start_idx + k];
+                        if (j >= vi)
+                        {
+                            ++k;
+                            j = 0;
+                            continue;
+                        }
+                        if (varsets[op.fun->arg_type_ids[k]].vars[j].first_write >= i) // var was not written before
+                        {
+                            ++j;
+                            continue;
+                        }
+
+                        out = t;
+                        out.arg_indices[op.args_start_idx + k] = j;
+                        ++j;
+                        return true;
+                    }
+                    curr = stage::done;
+                    break;
+
+                case stage::done:
+                    return false;
+                }
+            }
+        }
+    };
+
+    candidate_generator gen;
 
     // collect vars
     for (auto i = 0; i < int(ops.size()); ++i)
@@ -1272,22 +3705,31 @@ nx::minimize_options<nx::MonteCarloTest::machine_trace> nx::MonteCarloTest::mach
         auto const& op = ops[i];
 
         if (op.return_value_idx != -1)
-            varsets[op.fun->return_type].report_write(i, op.return_value_idx);
+            gen.varset(op.fun->return_type_id).report_write(i, op.return_value_idx);
 
         for (auto ai = 0; ai < op.fun->arity(); ++ai)
         {
-            auto& vs = varsets[op.fun->arg_types[ai]];
+            auto& vs = gen.varset(op.fun->arg_type_ids[ai]);
             auto idx = arg_indices[op.args_start_idx + ai];
 
             vs.report_read(i, idx);
-            if (op.fun->arg_types_could_change[ai])
+            if (op.fun->arg_types_could_change[ai] || op.fun->arg_types_consumed[ai])
                 vs.report_write(i, idx);
         }
     }
 
-    auto can_disable_fun = cc::array<bool>::defaulted(ops.size());
+    // slice of the last op
+    if (!ops.empty())
+    {
+        gen.in_slice = backward_slice(int(ops.size()) - 1);
+        auto slice_size = 0;
+        for (auto i = 0; i < int(ops.size()); ++i)
+            slice_size += int(gen.in_slice[i]);
+        gen.try_slice = slice_size < int(ops.size());
+    }
 
-    // try disabling functions
+    // which functions can be disabled
+    gen.can_disable_fun = cc::vector<bool>::filled(ops.size(), false);
     auto disable_cnt = 0;
     for (int i = 0; i < int(ops.size()); ++i)
     {
@@ -1299,7 +3741,7 @@ nx::minimize_options<nx::MonteCarloTest::machine_trace> nx::MonteCarloTest::mach
             can_disable = true;
         else
         {
-            auto const& vi = varsets.get(op.fun->return_type).vars[op.return_value_idx];
+            auto const& vi = gen.varsets[op.fun->return_type_id].vars[op.return_value_idx];
 
             // not the first write
             if (i > vi.first_write)
@@ -1310,101 +3752,15 @@ nx::minimize_options<nx::MonteCarloTest::machine_trace> nx::MonteCarloTest::mach
                 can_disable = true;
         }
 
-        can_disable_fun[i] = can_disable;
+        gen.can_disable_fun[i] = can_disable;
         if (can_disable)
             ++disable_cnt;
     }
 
-    // exponential disable
-    if (disable_cnt > 10)
-    {
-        auto seed = get_seed() + complexity();
-        min.options.emplace_back(
-            [can_disable_fun, seed](machine_trace const& old_t)
-            {
-                tg::rng rng;
-                rng.seed(seed);
-                auto t = old_t;
-                t.ops.clear();
-                for (auto i = 0; i < int(old_t.ops.size()); ++i)
-                    if (!can_disable_fun[i] || tg::uniform<bool>(rng))
-                        t.ops.push_back(old_t.ops[i]);
-                t.ops.pop_back();
-                return t;
-            });
-    }
-
-    // disable single functions
-    for (int i = 0; i < int(ops.size()); ++i)
-        if (can_disable_fun[i])
-            min.options.emplace_back(
-                [i](machine_trace const& old_t)
-                {
-                    auto t = old_t;
-                    for (auto j = i + 1; j < int(t.ops.size()); ++j)
-                        t.ops[j - 1] = t.ops[j];
-                    t.ops.pop_back();
-                    return t;
-                });
-
-    // try to rename complete vars
-    for (auto const& kvp : varsets)
-    {
-        auto type = kvp.key;
-        CC_ASSERT(type != typeid(void));
-        auto const& vs = kvp.value;
-        for (int i_from = int(vs.vars.size()) - 1; i_from > 0; --i_from)
-        {
-            if (!vs.vars[i_from].has_reads && !vs.vars[i_from].has_writes)
-                continue; // unused var slot
-
-            for (int i_to = 0; i_to < i_from; ++i_to)
-                min.options.emplace_back(
-                    [type, i_from, i_to](machine_trace const& old_t)
-                    {
-                        auto t = old_t;
-                        for (auto& op : t.ops)
-                        {
-                            // rename return val
-                            if (op.fun->return_type == type && op.return_value_idx == i_from)
-                                op.return_value_idx = i_to;
-
-                            // rename args
-                            for (auto ai = 0; ai < op.fun->arity(); ++ai)
-                                if (op.fun->arg_types[ai] == type && t.arg_indices[op.args_start_idx + ai] == i_from)
-                                    t.arg_indices[op.args_start_idx + ai] = i_to;
-                        }
-                        return t;
-                    });
-        }
-    }
-
-    // try to use different args
-    for (int i = 0; i < int(ops.size()); ++i)
-    {
-        auto const& op = ops[i];
-        for (auto ai = 0; ai < op.fun->arity(); ++ai)
-        {
-            auto vi = arg_indices[op.args_start_idx + ai];
-            auto const& vs = varsets.get(op.fun->arg_types[ai]);
-            for (auto j = 0; j < vi; ++j)
-            {
-                if (vs.vars[j].first_write >= i)
-                    continue; // var was not written before
-
-                min.options.emplace_back(
-                    [i, ai, j](machine_trace const& old_t)
-                    {
-                        auto t = old_t;
-                        auto const& op = t.ops[i];
-                        t.arg_indices[op.args_start_idx + ai] = j;
-                        return t;
-                    });
-            }
-        }
-    }
+    gen.try_exponential_disable = disable_cnt > 10;
+    gen.seed = get_seed() + complexity();
 
-    return min;
+    return minimize_options<machine_trace>::from_generator(cc::move(gen));
 }
 
 int nx::MonteCarloTest::machine_trace::complexity() const
@@ -1425,30 +3781,79 @@ int nx::MonteCarloTest::machine_trace::complexity() const
     return c;
 }
 
-void nx::MonteCarloTest::reproduceTrace(cc::span<int const> serialized_trace) { replayTrace(deserializeTrace(serialized_trace), true); }
+void nx::MonteCarloTest::reproduceTrace(cc::span<int const> serialized_trace)
+{
+    auto const trace = deserializeTrace(serialized_trace);
+    reportSwarmConfiguration(trace);
+    replayTrace(trace, true);
+}
 
-nx::MonteCarloTest::machine_trace nx::MonteCarloTest::deserializeTrace(cc::span<const int> serialized_trace)
+void nx::MonteCarloTest::reportSwarmConfiguration(machine_trace const& trace)
 {
-    machine_trace trace;
+    if (!trace.is_swarm)
+        return;
 
-    auto pos = 0;
-    auto const get_int = [&] { return serialized_trace[pos++]; };
+    auto const funs = traceFunctions(trace.equiv);
+    auto num_ops = 0;
+    for (auto f : funs)
+        if (!f->is_invariant)
+            ++num_ops;
 
-    // equivalence and functions
-    auto eq_idx = get_int();
+    if (trace.swarm_disabled.empty())
+    {
+        RICH_LOG_ERROR("swarm configuration of the failing session: all {} ops enabled", num_ops);
+        return;
+    }
+
+    RICH_LOG_ERROR("swarm configuration of the failing session: {} of {} ops disabled", trace.swarm_disabled.size(), num_ops);
+    for (auto fi : trace.swarm_disabled)
+        RICH_LOG_ERROR("  .. disabled [{}]", funs[fi]->name);
+}
+
+cc::vector<nx::MonteCarloTest::function*> nx::MonteCarloTest::traceFunctions(equivalence const* eq)
+{
     cc::vector<function*> funs;
-    if (eq_idx == -1)
+    if (!eq)
     {
         for (auto& f : mFunctions)
             funs.push_back(&f);
     }
     else
     {
-        trace.equiv = &mEquivalences[eq_idx];
+        cc::vector<cc::vector<function*>> funs_impls;
+        machine::collect_equivalence_functions(*this, *eq, funs, funs_impls);
+    }
+    return funs;
+}
+
+nx::MonteCarloTest::machine_trace nx::MonteCarloTest::deserializeTrace(cc::span<const int> serialized_trace)
+{
+    machine_trace trace;
+
+    auto pos = 0;
+    auto const get_int = [&]
+    {
+        CC_ASSERT(pos < int(serialized_trace.size()) && "truncated trace");
+        return serialized_trace[pos++];
+    };
 
-        cc::vector<function*> funs_b;
-        machine::build_equivalence_checker(*this, *trace.equiv, funs, funs_b);
+    // equivalence and swarm configuration
+    auto eq_idx = get_int();
+    if (eq_idx >= swarm_trace_header)
+    {
+        eq_idx -= swarm_trace_header + 1;
+        trace.is_swarm = true;
+        auto const num_disabled = get_int();
+        for (auto i = 0; i < num_disabled; ++i)
+            trace.swarm_disabled.push_back(get_int());
     }
+    CC_ASSERT(-1 <= eq_idx && eq_idx < int(mEquivalences.size()) && "invalid trace");
+    if (eq_idx >= 0)
+        trace.equiv = &mEquivalences[eq_idx];
+
+    auto const funs = traceFunctions(trace.equiv);
+    for (auto fi : trace.swarm_disabled)
+        CC_ASSERT(0 <= fi && fi < int(funs.size()) && "invalid trace");
 
     // rest of trace
     while (pos < int(serialized_trace.size()))
@@ -1456,35 +3861,47 @@ nx::MonteCarloTest::machine_trace nx::MonteCarloTest::deserializeTrace(cc::span<
         auto& op = trace.ops.emplace_back();
         op.seed = get_int();
         op.function_idx = get_int();
+        CC_ASSERT(0 <= op.function_idx && op.function_idx < int(funs.size()) && "invalid trace (recorded for another test?)");
         op.fun = funs[op.function_idx];
         op.return_value_idx = get_int();
         auto arity = get_int();
-        CC_ASSERT(arity == op.fun->arity() && "invalid trace");
+        CC_ASSERT(arity == op.fun->arity() && "invalid trace (recorded for another test?)");
         op.args_start_idx = int(trace.arg_indices.size());
         for (auto ai = 0; ai < arity; ++ai)
-            trace.arg_indices.push_back(get_int());
+        {
+            auto const vi = get_int();
+            CC_ASSERT(vi >= 0 && "invalid trace");
+            trace.arg_indices.push_back(vi);
+        }
     }
 
     return trace;
 }
 
-cc::string nx::MonteCarloTest::machine_trace::serialize_to_string(MonteCarloTest const& test) const
+cc::vector<int> nx::MonteCarloTest::machine_trace::serialize(MonteCarloTest const& test) const
 {
     cc::vector<int> trace;
 
     // equiv
-    if (!equiv)
-        trace.push_back(-1);
-    else
+    auto eq_idx = -1;
+    if (equiv)
     {
         for (auto i = 0; i < int(test.mEquivalences.size()); ++i)
             if (&test.mEquivalences[i] == equiv)
-            {
-                trace.push_back(i);
-                break;
-            }
+                eq_idx = i;
+        CC_ASSERT(eq_idx >= 0);
+    }
+
+    // swarm configuration
+    if (is_swarm)
+    {
+        trace.push_back(swarm_trace_header + eq_idx + 1);
+        trace.push_back(int(swarm_disabled.size()));
+        for (auto fi : swarm_disabled)
+            trace.push_back(fi);
     }
-    CC_ASSERT(trace.size() == 1);
+    else
+        trace.push_back(eq_idx);
 
     // serialize ops
     for (auto const& op : ops)
@@ -1497,5 +3914,7 @@ cc::string nx::MonteCarloTest::machine_trace::serialize_to_string(MonteCarloTest
             trace.push_back(arg_indices[op.args_start_idx + ai]);
     }
 
-    return nx::detail::trace_encode(trace);
+    return trace;
 }
+
+cc::string nx::MonteCarloTest::machine_trace::serialize_to_string(MonteCarloTest const& test) const { return nx::detail::trace_encode(serialize(test)); }
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
 #include <typeindex>
 #include <typeinfo>
 #include <utility>
@@ -8,6 +12,7 @@
 #include <clean-core/has_operator.hh>
 #include <clean-core/invoke.hh>
 #include <clean-core/map.hh>
+#include <clean-core/set.hh>
 #include <clean-core/span.hh>
 #include <clean-core/string.hh>
 #include <clean-core/unique_function.hh>
@@ -31,10 +36,18 @@ class NX_API MonteCarloTest
     // fwd
 private:
     struct machine;
+    struct machine_cache;
+    struct profile_stats;
+    struct speedup_stats;
+    struct replay_checkpoints;
+    struct compiled_trace;
     struct value;
+    struct value_arena;
     struct constant;
     struct function;
+    struct equivalence;
     struct machine_trace;
+    struct exhaustive_enumerator;
 
     // setup
 public:
@@ -42,9 +55,11 @@ public:
     function& addOp(cc::string name, F&& f)
     {
         auto sig = detail::make_signature(cc::forward<F>(f));
-        mFunctions.emplace_back(cc::move(name), detail::make_function(cc::forward<F>(f)), sig);
+        auto& fun = mFunctions.emplace_back(cc::move(name), detail::make_function(cc::forward<F>(f)), sig);
+        fun.idx = int(mFunctions.size()) - 1;
         registerFunctionType(sig);
-        return mFunctions.back();
+        assignTypeIds(fun);
+        return fun;
     }
 
     template <class F>
@@ -62,6 +77,7 @@ public:
     {
         auto& f = addOp(cc::move(name), [v = cc::forward<T>(v)] { return v; });
         f.execute_at_least(0); // optional
+        f.make_deterministic();
     }
 
     void addPreSessionCallback(cc::unique_function<void()> f);
@@ -79,21 +95,60 @@ public:
     {
         implTestEquivalence(detail::make_function(cc::forward<F>(test)), detail::make_signature(cc::forward<F>(test)));
     }
-    template <class A, class B>
+    /// testEquivalence<Ref, Impl>() or testEquivalence<Ref, ImplA, ImplB, ...>() (see testEquivalenceGroup)
+    template <class Ref, class Impl, class... Impls>
     void testEquivalence()
     {
-        testEquivalence([](A const& a, B const& b) { REQUIRE(a == b); });
+        testEquivalenceGroup<Ref, Impl, Impls...>([](Ref const& a, auto const& b) { REQUIRE(a == b); });
+    }
+    /// checks multiple implementations against a reference in the same sessions
+    /// all of them execute the same ops on the same inputs, results are compared against the reference
+    /// F: (Ref const&, Impl const&) -> void or bool for each Impl (e.g. a generic lambda)
+    template <class Ref, class Impl, class... Impls, class F>
+    void testEquivalenceGroup(F&& test)
+    {
+        auto& eq = mEquivalences.emplace_back(typeid(Ref));
+        eq.impls.emplace_back(typeid(Impl), makeEquivalenceTest<Ref, Impl>(test));
+        (eq.impls.emplace_back(typeid(Impls), makeEquivalenceTest<Ref, Impls>(test)), ...);
     }
 
     template <class T, class F>
     void setPrinter(F&& f)
     {
-        mTypeMetadata[std::type_index(typeid(T))].to_string = [f = cc::move(f)](void* p) { return f(*static_cast<T const*>(p)); };
+        mTypeMetadata[typeIdOf(typeid(T))].to_string = [f = cc::move(f)](void* p) { return f(*static_cast<T const*>(p)); };
+    }
+
+    /// hash of a value's state, used to measure state coverage (number of distinct states per type)
+    /// sampling is biased towards ops that keep producing new states
+    /// F: (T const&) -> integer hash
+    /// NOTE: arithmetic and enum types are hashed automatically once coverage is enabled
+    template <class T, class F>
+    void setHasher(F&& f)
+    {
+        static_assert(std::is_invocable_v<F, T const&>, "hasher must be callable with (T const&)");
+        mTypeMetadata[typeIdOf(typeid(T))].hash = [f = cc::move(f)](void const* p) { return uint64_t(f(*static_cast<T const*>(p))); };
+        mTrackStates = true;
     }
 
+    /// enables state coverage without custom hashers (e.g. if all relevant types are hashed automatically)
+    void enableStateCoverage() { mTrackStates = true; }
+
     // allows wrapping a scope around the actual MCT execute
     void setExecuteWrapper(cc::unique_function<void(cc::unique_function<void()>)> fun) { mExecuteExecuter = cc::move(fun); }
 
+    /// sessions (and minimization replays) run in parallel if requested via mct_threads or --mct-threads
+    /// exhaustive checks use all hardware threads unless mct_threads says otherwise
+    /// tests whose ops or callbacks touch global state must opt out
+    void disableParallelSessions() { mAllowParallelSessions = false; }
+
+    /// limits the effort spent on minimizing a failing trace (the smallest failing trace so far is reported)
+    /// seconds <= 0 or replays < 0 means unlimited (default, i.e. minimization runs until no smaller trace fails)
+    void setMinimizationBudget(double seconds, int replays = -1)
+    {
+        mMinimizationSeconds = seconds;
+        mMinimizationReplays = replays;
+    }
+
     MonteCarloTest();
     MonteCarloTest(MonteCarloTest const&) = delete;
     MonteCarloTest& operator=(MonteCarloTest const&) = delete;
@@ -108,81 +163,228 @@ public:
 private:
     void implExecute();
 
-    void tryExecuteMachineNormally(machine_trace& trace, size_t seed);
+    void tryExecuteMachineNormally(machine_cache& machines, machine_trace& trace, size_t seed);
+
+    /// number of threads for normal sessions (see nx::mct_threads)
+    int sessionThreads() const;
+
+    /// runs independent sessions on multiple threads (one per thread or until the first failure if endless)
+    /// returns false and sets failing_trace to the first failing session
+    bool tryExecuteSessionsParallel(machine_trace& failing_trace, int num_threads, bool endless);
+
+    /// replays all op sequences up to the given depth (see nx::exhaustive)
+    /// returns false and sets failing_trace if one of them fails
+    bool tryExecuteExhaustive(machine_trace& failing_trace, int depth, int rng_choices);
+
+    /// number of threads for replaying independent traces (minimization, and exhaustive checks with mct_threads)
+    /// same as sessionThreads(), i.e. sequential unless requested via mct_threads
+    int replayThreads() const;
+
+    /// number of threads for exhaustive checks
+    /// all hardware threads unless set via mct_threads (sequential for debug, callbacks or disableParallelSessions())
+    int exhaustiveThreads() const;
+
+    /// replays the traces on one thread per machine cache
+    /// returns the lowest index of a failing trace or -1 (deterministic regardless of thread count)
+    int replayFirstFailing(cc::span<machine_cache> machines, cc::span<machine_trace const> traces, replay_checkpoints const* checkpoints = nullptr);
+
+    /// prints the profile of the sampled sessions and stores it as json in the current test (see nx::mct_profile)
+    void reportProfile(profile_stats const& profile) const;
+    /// prints the speedup of each equivalence implementation over its reference (see nx::mct_speedup)
+    void reportSpeedups(speedup_stats const& speedups) const;
+    /// fails for implementation ops that are slower than the reference by more than max_slowdown (with confidence)
+    void checkSpeedups(speedup_stats const& speedups, double max_slowdown) const;
+    /// prints the number of distinct states visited per type (see setHasher)
+    void reportCoverage(cc::span<cc::set<uint64_t> const> visited_states) const;
+
+    /// replays the trace repeatedly via compiled_trace (no invariants, no equivalence checks)
+    /// and reports per-op latencies and total throughput (for each side of an equivalence trace)
+    void benchmarkTrace(machine_trace const& trace);
+
+    /// prints the ops that were disabled in the session of a swarm trace (see nx::mct_swarm)
+    void reportSwarmConfiguration(machine_trace const& trace);
 
     void minimizeTrace(machine_trace& trace);
     void reproduceTrace(cc::span<int const> serialized_trace);
 
+    /// functions indexed by machine_trace::op::function_idx for traces of the given equivalence (or nullptr)
+    cc::vector<function*> traceFunctions(equivalence const* eq);
     machine_trace deserializeTrace(cc::span<int const> serialized_trace);
 
     /// tries to replace a trace
     /// returns false if trace is invalid (e.g. violates a precondition)
     bool replayTrace(machine_trace const& trace, bool print_mode = false);
+    /// same but with explicit machines (e.g. one set per thread)
+    /// resume_from: skips the longest op prefix shared with a recorded trace (see replay_checkpoints)
+    /// record_into: takes snapshots while replaying (the trace must be the one the checkpoints were started with)
+    bool replayTrace(machine_cache& machines,
+                     machine_trace const& trace,
+                     bool print_mode = false,
+                     replay_checkpoints const* resume_from = nullptr,
+                     replay_checkpoints* record_into = nullptr);
+    /// non-printing replay via compiled_trace
+    bool replayCompiled(machine_cache& machines, machine_trace const& trace, replay_checkpoints const* resume_from, replay_checkpoints* record_into);
+
+    /// checks the results and mutated args of an op executed on the reference and an implementation of an equivalence
+    void checkEquivalentResults(equivalence const& e,
+                                int impl,
+                                function const* f_a,
+                                function const* f_b,
+                                value const& va,
+                                value const& vb,
+                                cc::span<value*> args_a,
+                                cc::span<value*> args_b) const;
 
     template <class F, class R, class A, class B>
     void implTestEquivalence(F&& test, detail::signature<R(A, B)>)
     {
         static_assert(std::is_invocable_v<F, A const&, B const&>, "function must be callable with (A const&, B const&)");
-        auto& eq = mEquivalences.emplace_back(typeid(A), typeid(B));
+        auto& eq = mEquivalences.emplace_back(typeid(A));
+        eq.impls.emplace_back(typeid(B), makeEquivalenceTest<std::decay_t<A>, std::decay_t<B>>(cc::move(test)));
+    }
+
+    template <class A, class B, class F>
+    static cc::unique_function<void(value const&, value const&)> makeEquivalenceTest(F test)
+    {
+        static_assert(std::is_invocable_v<F&, A const&, B const&>, "function must be callable with (A const&, B const&)");
+        using R = std::invoke_result_t<F&, A const&, B const&>;
         if constexpr (std::is_same_v<R, void>)
-            eq.test = [test = cc::move(test)](value const& va, value const& vb)
+            return [test = cc::move(test)](value const& va, value const& vb)
             {
-                auto const& a = *static_cast<std::decay_t<A> const*>(va.ptr);
-                auto const& b = *static_cast<std::decay_t<B> const*>(vb.ptr);
+                auto const& a = *static_cast<A const*>(va.get());
+                auto const& b = *static_cast<B const*>(vb.get());
                 test(a, b);
             };
         else if constexpr (std::is_same_v<R, bool>)
-            eq.test = [test = cc::move(test)](value const& va, value const& vb)
+            return [test = cc::move(test)](value const& va, value const& vb)
             {
-                auto const& a = *static_cast<std::decay_t<A> const*>(va.ptr);
-                auto const& b = *static_cast<std::decay_t<B> const*>(vb.ptr);
+                auto const& a = *static_cast<A const*>(va.get());
+                auto const& b = *static_cast<B const*>(vb.get());
                 CHECK(test(a, b));
             };
         else
             static_assert(cc::always_false<A, B>, "equivalence test must either return void or bool");
     }
 
+    /// per-session bump allocator for values that do not fit inline
+    /// memory is only released as a whole, either on reset (at session end) or when the arena dies
+    struct value_arena
+    {
+        void* allocate(size_t size, size_t align);
+
+        /// makes all memory available again (all values must already be destroyed)
+        /// NOTE: keeps the blocks around for the next session
+        void reset();
+
+        value_arena() = default;
+        value_arena(value_arena&& rhs) noexcept;
+        value_arena& operator=(value_arena&& rhs) noexcept;
+        value_arena(value_arena const&) = delete;
+        value_arena& operator=(value_arena const&) = delete;
+        ~value_arena();
+
+    private:
+        void release();
+
+        cc::vector<std::byte*> blocks;       // fixed-size, reused after reset
+        cc::vector<std::byte*> large_blocks; // one per large value, freed on reset
+        int current_block = -1;
+        std::byte* head = nullptr;
+        size_t remaining = 0;
+    };
+
     struct value
     {
         using deleter_t = void (*)(void*);
 
-        void* ptr = nullptr;
-        deleter_t deleter = nullptr;
+        static constexpr size_t inline_size = 3 * sizeof(void*);
+        static constexpr size_t inline_align = alignof(void*);
+
+        // small trivially copyable types are stored inline (moving is a memcpy)
+        // everything else lives in the arena of the session and is only destroyed (not freed) here
+        template <class T>
+        static constexpr bool is_stored_inline = sizeof(T) <= inline_size && alignof(T) <= inline_align && std::is_trivially_copyable_v<T>;
+
         std::type_index type;
 
         value() : type(typeid(void)) {}
 
         bool is_void() const { return type == typeid(void); }
 
-        template <class T>
-        value(T* v) : ptr(v), deleter([](void* p) { delete static_cast<T*>(p); }), type(typeid(T))
+        void* get() const { return is_inline ? const_cast<std::byte*>(storage) : ptr; }
+
+        /// void result of an op that returned one of its args (see function::may_return_arg)
+        /// the arg stays in its slot, the result only refers to it
+        static value returned_arg(value* arg)
         {
+            value v;
+            v.ptr = arg;
+            return v;
         }
-        value(value&& rhs) noexcept : type(rhs.type)
+
+        /// the arg returned by the op (see returned_arg), nullptr for all other values
+        value const* get_returned_arg() const { return is_void() ? static_cast<value const*>(ptr) : nullptr; }
+
+        template <class T, class... Args>
+        static value make(value_arena& arena, Args&&... args)
         {
-            ptr = rhs.ptr;
-            deleter = rhs.deleter;
-            rhs.ptr = nullptr;
-            rhs.deleter = nullptr;
+            value v;
+            v.type = typeid(T);
+            if constexpr (is_stored_inline<T>)
+            {
+                new (v.storage) T(cc::forward<Args>(args)...);
+                v.is_inline = true;
+            }
+            else if constexpr (alignof(T) <= alignof(std::max_align_t))
+            {
+                v.ptr = new (arena.allocate(sizeof(T), alignof(T))) T(cc::forward<Args>(args)...);
+                if constexpr (!std::is_trivially_destructible_v<T>)
+                    v.deleter = [](void* p) { static_cast<T*>(p)->~T(); };
+            }
+            else // over-aligned types are not supported by the arena
+            {
+                v.ptr = new T(cc::forward<Args>(args)...);
+                v.deleter = [](void* p) { delete static_cast<T*>(p); };
+            }
+            return v;
         }
+
+        value(value&& rhs) noexcept : type(rhs.type) { steal(rhs); }
         value& operator=(value&& rhs) noexcept
         {
-            if (ptr)
-                deleter(ptr);
-
-            ptr = rhs.ptr;
-            deleter = rhs.deleter;
+            destroy();
             type = rhs.type;
-            rhs.ptr = nullptr;
-            rhs.deleter = nullptr;
-
+            steal(rhs);
             return *this;
         }
-        ~value()
+        ~value() { destroy(); }
+
+    private:
+        void destroy()
         {
-            if (ptr)
+            if (!is_inline && deleter)
                 deleter(ptr);
         }
+        void steal(value& rhs)
+        {
+            is_inline = rhs.is_inline;
+            deleter = rhs.deleter;
+            if (is_inline)
+                std::memcpy(storage, rhs.storage, inline_size);
+            else
+                ptr = rhs.ptr;
+            rhs.is_inline = false;
+            rhs.deleter = nullptr;
+            rhs.ptr = nullptr;
+        }
+
+        union
+        {
+            void* ptr = nullptr;
+            alignas(inline_align) std::byte storage[inline_size];
+        };
+        deleter_t deleter = nullptr;
+        bool is_inline = false;
     };
 
     struct constant
@@ -197,8 +399,19 @@ private:
         template <class R, class F, size_t... I>
         static R apply(F&& f, [[maybe_unused]] cc::span<value*> inputs, std::index_sequence<I...>)
         {
-            // TODO: proper rvalue ref support (maybe via forward?)
-            return cc::invoke(f, (*static_cast<std::decay_t<Args>*>(inputs[I]->ptr))...);
+            return cc::invoke(f, arg<Args>(inputs[I])...);
+        }
+
+        // T&& args consume the stored value (the machine empties the slot after the op, see function::arg_types_consumed)
+        // all other args are passed as lvalues, i.e. by-value args are copies and the stored value stays intact
+        template <class Arg>
+        static decltype(auto) arg(value* v)
+        {
+            auto& a = *static_cast<std::decay_t<Arg>*>(v->get());
+            if constexpr (std::is_rvalue_reference_v<Arg>)
+                return cc::move(a);
+            else
+                return a;
         }
     };
 
@@ -214,21 +427,76 @@ private:
             return *this;
         }
 
+        /// invariants only: checks only every k-th time the invariant applies
+        /// NOTE: sparsely checked invariants are also checked for all values still alive at session end,
+        ///       but a violating value that is replaced or consumed before its next scheduled check is missed
+        ///       replays (minimization, reproduction) check every invariant after every op,
+        ///       so a failure that was found is still attributed to the first violating op
+        function& check_every(int k)
+        {
+            CC_CONTRACT(is_invariant && "only invariants can be scheduled");
+            CC_CONTRACT(k > 0);
+            invariant_schedule = check_schedule::every_k;
+            invariant_every = k;
+            return *this;
+        }
+        /// invariants only: checks with probability p each time the invariant applies (see check_every)
+        function& check_with_probability(float p)
+        {
+            CC_CONTRACT(is_invariant && "only invariants can be scheduled");
+            CC_CONTRACT(0 < p && p <= 1);
+            invariant_schedule = check_schedule::probabilistic;
+            invariant_probability = p;
+            return *this;
+        }
+        /// invariants only: checks all values only once at session end (see check_every)
+        function& check_at_session_end()
+        {
+            CC_CONTRACT(is_invariant && "only invariants can be scheduled");
+            invariant_schedule = check_schedule::session_end;
+            return *this;
+        }
+
+        /// relative sampling probability (default 1)
+        /// with session budgets (nx::mct_ops, nx::mct_time) this is the relative share of session time instead
+        function& weight(float w)
+        {
+            CC_CONTRACT(w > 0);
+            sample_weight = w;
+            return *this;
+        }
+
         template <class F, class R, class... Args>
         function(cc::string name, F&& f, detail::signature<R(Args...)>) : name(cc::move(name)), return_type(typeid(std::decay_t<R>))
         {
             (arg_types.emplace_back(typeid(std::decay_t<Args>)), ...);
-            (arg_types_could_change.push_back(std::is_reference_v<Args> && !std::is_const_v<std::remove_reference_t<Args>>), ...);
+            (arg_types_could_change.push_back(std::is_lvalue_reference_v<Args> && !std::is_const_v<std::remove_reference_t<Args>>), ...);
+            (arg_types_consumed.push_back(std::is_rvalue_reference_v<Args> && !std::is_const_v<std::remove_reference_t<Args>>), ...);
+            consumes_args = ((std::is_rvalue_reference_v<Args> && !std::is_const_v<std::remove_reference_t<Args>>) || ... || false);
+
+            // ops returning a mutable reference of an arg type (e.g. builders returning *this) might return one of their args
+            using RV = std::decay_t<R>;
+            constexpr auto may_alias = std::is_lvalue_reference_v<R> && !std::is_const_v<std::remove_reference_t<R>>
+                                       && (std::is_same_v<RV, std::decay_t<Args>> || ... || false);
+            may_return_arg = may_alias;
 
-            execute = [f = cc::forward<F>(f)](cc::span<value*> inputs) -> value
+            execute = [f = cc::forward<F>(f)](cc::span<value*> inputs, value_arena& arena) -> value
             {
                 if constexpr (std::is_same_v<R, void>)
                 {
-                    executor<Args...>::template apply<std::decay_t<R>>(f, inputs, std::index_sequence_for<Args...>());
+                    executor<Args...>::template apply<void>(f, inputs, std::index_sequence_for<Args...>());
                     return {};
                 }
+                else if constexpr (may_alias)
+                {
+                    auto& r = executor<Args...>::template apply<R>(f, inputs, std::index_sequence_for<Args...>());
+                    for (auto v : inputs)
+                        if (v->get() == &r)
+                            return value::returned_arg(v); // mutated in place, there is no new value to store (see may_return_arg)
+                    return value::make<RV>(arena, r);
+                }
                 else
-                    return new std::decay_t<R>(executor<Args...>::template apply<std::decay_t<R>>(f, inputs, std::index_sequence_for<Args...>()));
+                    return value::make<RV>(arena, executor<Args...>::template apply<RV>(f, inputs, std::index_sequence_for<Args...>()));
             };
         }
 
@@ -300,12 +568,22 @@ private:
             return *this;
         }
 
+        /// ops without args only: the op always returns the same value (no hidden or global state)
+        /// exhaustive enumeration (nx::exhaustive) then executes it at most once per sequence
+        function& make_deterministic()
+        {
+            CC_CONTRACT(arg_types.empty() && "only ops without args can be deterministic");
+            is_deterministic = true;
+            return *this;
+        }
+
     private:
         template <class F, class R, class... Args>
         void set_precondition(F&& f, detail::signature<R(Args...)>)
         {
             CC_ASSERT(!precondition && "already has a precondition");
             static_assert(std::is_same_v<R, bool>, "precondition must return bool");
+            static_assert(!(std::is_rvalue_reference_v<Args> || ... || false), "preconditions must not consume args (take them by const&)");
 
             cc::capped_vector<std::type_index, sizeof...(Args)> p_types;
             (p_types.emplace_back(typeid(std::decay_t<Args>)), ...);
@@ -323,7 +601,7 @@ private:
                     for (auto v : inputs)
                         if (v->type == p_type)
                         {
-                            if (!cc::invoke(f, (*static_cast<std::decay_t<Args>*>(v->ptr))...))
+                            if (!cc::invoke(f, (*static_cast<std::decay_t<Args>*>(v->get()))...))
                                 return false;
                         }
                     return true;
@@ -344,27 +622,52 @@ private:
 
     private:
         cc::string name;
-        cc::unique_function<value(cc::span<value*>)> execute;
+        cc::unique_function<value(cc::span<value*>, value_arena&)> execute;
         cc::unique_function<bool(cc::span<value*>)> precondition;
         cc::vector<std::type_index> arg_types;
         cc::vector<bool> arg_types_could_change;
+        cc::vector<bool> arg_types_consumed; // T&& args, their slots are empty after the op until a later op refills them
+        bool consumes_args = false;
+        bool may_return_arg = false; // results that alias an arg are not stored (the op returns a void value referring to the arg instead)
         std::type_index return_type;
+        cc::vector<int> arg_type_ids; // dense type ids (see MonteCarloTest::typeIdOf)
+        int return_type_id = -1;      // -1 for void
         bool is_invariant = false;
+        bool is_deterministic = false;
         int min_executions = 100;
-        int executions = 0;
-        int internal_idx = -1;
+        float sample_weight = 1;
+
+        enum class check_schedule
+        {
+            always,
+            every_k,
+            probabilistic,
+            session_end
+        };
+        check_schedule invariant_schedule = check_schedule::always; // only used while sampling sessions
+        int invariant_every = 1;
+        float invariant_probability = 1;
+        int idx = -1; // index in mFunctions
         bool is_optional = false;
 
         friend class MonteCarloTest;
     };
 
+    /// a reference type and one or more implementations that are driven by the same ops
     struct equivalence
     {
+        struct implementation
+        {
+            std::type_index type;
+            cc::unique_function<void(value const&, value const&)> test; // (reference, implementation)
+
+            implementation(std::type_index t, cc::unique_function<void(value const&, value const&)> f) : type(t), test(cc::move(f)) {}
+        };
+
         std::type_index type_a;
-        std::type_index type_b;
-        cc::unique_function<void(value const&, value const&)> test;
+        cc::vector<implementation> impls;
 
-        equivalence(std::type_index a, std::type_index b) : type_a(a), type_b(b) {}
+        explicit equivalence(std::type_index a) : type_a(a) {}
     };
 
     struct machine_trace
@@ -382,12 +685,21 @@ private:
         cc::vector<op> ops;
         cc::vector<int> arg_indices;
 
+        // swarm configuration of the session (see nx::mct_swarm)
+        bool is_swarm = false;
+        cc::vector<int> swarm_disabled; // function_idx of the disabled ops
+
         int complexity() const;
 
         void start(equivalence const* eq);
 
         minimize_options<machine_trace> build_minimizer() const;
 
+        /// ops that op_idx (transitively) depends on via its args, including ops that mutate them
+        /// (contains op_idx itself, ops after it are never part of the slice)
+        cc::vector<bool> backward_slice(int op_idx) const;
+
+        cc::vector<int> serialize(MonteCarloTest const& test) const;
         cc::string serialize_to_string(MonteCarloTest const& test) const;
     };
 
@@ -395,6 +707,8 @@ private:
     {
         cc::unique_function<cc::string(void*)> to_string;
         cc::unique_function<void(value const&, value const&)> check_equality;
+        cc::unique_function<value(value const&, value_arena&)> copy; // empty for non-copyable types
+        cc::unique_function<uint64_t(void const*)> hash;             // empty for types without hasher (see setHasher)
     };
 
     template <class R, class... Args>
@@ -406,19 +720,36 @@ private:
         (registerType<std::decay_t<Args>>(), ...);
     }
 
+    /// returns the dense id of a type (registers it if new)
+    int typeIdOf(std::type_index type);
+    /// returns -1 if type was never registered
+    int findTypeId(std::type_index type) const;
+    void assignTypeIds(function& f);
+
     template <class T>
     void registerType()
     {
-        auto& md = mTypeMetadata[typeid(T)];
+        auto& md = mTypeMetadata[typeIdOf(typeid(T))];
 
         if constexpr (cc::has_operator_equal<T>)
             md.check_equality = [](value const& va, value const& vb)
             {
-                auto const& a = *static_cast<T const*>(va.ptr);
-                auto const& b = *static_cast<T const*>(vb.ptr);
+                auto const& a = *static_cast<T const*>(va.get());
+                auto const& b = *static_cast<T const*>(vb.get());
                 CHECK(a == b);
             };
 
+        if constexpr (std::is_copy_constructible_v<T>)
+            md.copy = [](value const& v, value_arena& arena) { return value::make<T>(arena, *static_cast<T const*>(v.get())); };
+
+        if constexpr ((std::is_arithmetic_v<T> || std::is_enum_v<T>) && sizeof(T) <= sizeof(uint64_t))
+            md.hash = [](void const* p)
+            {
+                uint64_t h = 0;
+                std::memcpy(&h, p, sizeof(T));
+                return h;
+            };
+
 #ifdef NX_HAS_REFLECTOR
         if constexpr (rf::has_to_string<T>)
             md.to_string = [](void* p) { return rf::to_string(*static_cast<T const*>(p)); };
@@ -427,7 +758,10 @@ private:
 
     // members
 private:
-    cc::map<std::type_index, type_metadata> mTypeMetadata;
+    // registered types get dense ids (in order of registration)
+    cc::map<std::type_index, int> mTypeIds;
+    cc::vector<std::type_index> mTypes;      // id -> type
+    cc::vector<type_metadata> mTypeMetadata; // per type id
     cc::vector<function> mFunctions;
     cc::vector<cc::unique_function<void()>> mPreCallbacks;
     cc::vector<cc::unique_function<void()>> mPostCallbacks;
@@ -438,6 +772,13 @@ private:
     cc::unique_function<void(cc::unique_function<void()>)> mExecuteExecuter;
 
     machine_trace* mCurrentTrace = nullptr;
+    machine_cache* mMachines = nullptr; // only valid during execute()
+
+    bool mAllowParallelSessions = true;
+    bool mTrackStates = false; // see setHasher
+
+    double mMinimizationSeconds = 0;
+    int mMinimizationReplays = -1;
 
     friend class Test;
 };
@@ -1,5 +1,7 @@
 #include "Test.hh"
 
+#include <mutex>
+
 #include <clean-core/format.hh>
 
 #include "MonteCarloTest.hh"
@@ -18,6 +20,10 @@ cc::string nx::Test::makeCurrentReproductionCommand() const
 
 void nx::Test::setFirstFailInfo(const char* check, const char* file, int line, char const* function)
 {
+    // tests can fail on multiple threads at once (e.g. parallel MCT sessions)
+    static std::mutex m;
+    auto lock = std::lock_guard(m);
+
     if (mFirstFailMessage.empty())
     {
         mFirstFailMessage = check;
@@ -27,6 +33,14 @@ void nx::Test::setFirstFailInfo(const char* check, const char* file, int line, c
     }
 }
 
+void nx::Test::clearFirstFailInfo()
+{
+    mFirstFailMessage.clear();
+    mFirstFailFile.clear();
+    mFirstFailFunction.clear();
+    mFirstFailLine = 0;
+}
+
 cc::string nx::Test::makeFirstFailInfo() const
 {
     if (mFirstFailMessage.empty())
@@ -39,9 +39,34 @@ public:
     bool isEnabled() const { return mIsEnabled; }
     bool isDebug() const { return mIsDebug; }
     bool isVerbose() const { return mIsVerbose; }
+    bool isForkServer() const { return mIsForkServer; }
+    bool isPerfFuzz() const { return mIsPerfFuzz; }
+    int fuzzIterations() const { return mFuzzIterations; }
+    size_t fuzzCycles() const { return mFuzzCycles; }
+    bool isExhaustive() const { return mExhaustiveDepth > 0; }
+    int exhaustiveDepth() const { return mExhaustiveDepth; }
+    int exhaustiveRngChoices() const { return mExhaustiveRngChoices; }
+    int mctThreads() const { return mMctThreads; }
+    cc::string const& traceSaveDir() const { return mTraceSaveDir; }
+    cc::string const& traceCaptureDir() const { return mTraceCaptureDir; }
+    bool isMctBenchmark() const { return mIsMctBenchmark; }
+    bool isMctSwarm() const { return mIsMctSwarm; }
+    cc::string const& benchTrace() const { return mBenchTrace; }
+    bool isMctProfile() const { return mIsMctProfile; }
+    bool isMctSpeedup() const { return mIsMctSpeedup; }
+    double mctMaxSlowdown() const { return mMctMaxSlowdown; }
+    int mctOps() const { return mMctOps; }
+    double mctTimeMs() const { return mMctTimeMs; }
+    double mctScale() const { return mMctScale; }
+    cc::string const& mctProfileJson() const { return mMctProfileJson; }
 
     bool didFail() const { return mDidFail; }
 
+    cc::string const& firstFailMessage() const { return mFirstFailMessage; }
+    cc::string const& firstFailFile() const { return mFirstFailFile; }
+    cc::string const& firstFailFunction() const { return mFirstFailFunction; }
+    int firstFailLine() const { return mFirstFailLine; }
+
     int numberOfChecks() const { return mCounters->num_checks; }
     int numberOfFailedChecks() const { return mCounters->num_failed_checks; }
 
@@ -56,7 +81,48 @@ public:
     void setDisabled() { mIsEnabled = false; }
     void setDebug() { mIsDebug = true; }
     void setVerbose() { mIsVerbose = true; }
+    void setForkServer() { mIsForkServer = true; }
+    void setPerfFuzz() { mIsPerfFuzz = true; }
+    void setMctProfile() { mIsMctProfile = true; }
+    void setMctBenchmark() { mIsMctBenchmark = true; }
+    void setMctSwarm() { mIsMctSwarm = true; }
+    void setMctSpeedup(double maxSlowdown)
+    {
+        CC_CONTRACT(maxSlowdown == 0 || maxSlowdown >= 1);
+        mIsMctSpeedup = true;
+        mMctMaxSlowdown = maxSlowdown;
+    }
+    void setMctOps(int n)
+    {
+        CC_CONTRACT(n > 0);
+        mMctOps = n;
+    }
+    void setMctTime(double ms)
+    {
+        CC_CONTRACT(ms > 0);
+        mMctTimeMs = ms;
+    }
+    void setFuzzBudget(int iterations, size_t cycles)
+    {
+        CC_CONTRACT(iterations > 0);
+        CC_CONTRACT(cycles > 0);
+        mFuzzIterations = iterations;
+        mFuzzCycles = cycles;
+    }
+    void setExhaustive(int depth, int rngChoices)
+    {
+        CC_CONTRACT(depth > 0);
+        CC_CONTRACT(rngChoices > 0);
+        mExhaustiveDepth = depth;
+        mExhaustiveRngChoices = rngChoices;
+    }
+    void setMctThreads(int n)
+    {
+        CC_CONTRACT(n >= 0);
+        mMctThreads = n;
+    }
     void setReproduce(reproduce r) { mReproduction = r; }
+    void setMctProfileJson(cc::string json) { mMctProfileJson = cc::move(json); }
     void setMonteCarloTest(MonteCarloTest* mct) { mMCT = mct; }
     void addAfterPattern(cc::string pattern) { mAfterPatterns.push_back(cc::move(pattern)); }
     void addBeforePattern(cc::string pattern) { mBeforePatterns.push_back(cc::move(pattern)); }
@@ -79,6 +145,7 @@ public:
     cc::string makeCurrentReproductionCommand() const;
 
     void setFirstFailInfo(const char* check, const char* file, int line, char const* function);
+    void clearFirstFailInfo();
 
     cc::string makeFirstFailInfo() const;
     cc::string makeFirstFailMessage() const;
@@ -116,6 +183,25 @@ private:
     bool mIsEnabled = true;
     bool mIsDebug = false;
     bool mIsVerbose = false;
+    bool mIsForkServer = false;
+    bool mIsPerfFuzz = false;
+    bool mIsMctProfile = false;
+    bool mIsMctSpeedup = false;
+    bool mIsMctBenchmark = false;
+    bool mIsMctSwarm = false;
+    int mFuzzIterations = 1000;      // budget of a fuzz test run (see nx::fuzz_budget)
+    size_t mFuzzCycles = 10'000'000; //
+    int mExhaustiveDepth = 0;
+    int mExhaustiveRngChoices = 0;
+    int mMctThreads = -1;        // 0 means one per hardware thread, -1 means not set (sequential sessions)
+    int mMctOps = 0;             // session budget in ops (0 = none)
+    double mMctTimeMs = 0;       // session budget in ms (0 = none)
+    double mMctScale = 1;        // scales budgets and execute_at_least counts (--mct-scale)
+    double mMctMaxSlowdown = 0;  // fails slower equivalence implementations (0 = report only)
+    cc::string mTraceSaveDir;    // failing MCT traces are written there (if not empty)
+    cc::string mTraceCaptureDir; // sampled MCT sessions of passing tests are written there (if not empty)
+    cc::string mBenchTrace;      // MCT workload replayed as benchmark instead of sampling (text form, --bench-trace)
+    cc::string mMctProfileJson;  // set by MCTs with mct_profile after execution
 
     cc::string mFirstFailMessage;
     cc::string mFirstFailFile;
@@ -144,6 +230,7 @@ namespace detail
 {
 cc::vector<cc::unique_ptr<Test>>& get_all_tests();
 Test* get_current_test(); // TODO: discuss if and how this should be open API
+void set_current_test(Test* t);
 bool& is_silenced();      // TODO: discuss if and how this should be open API
 bool& always_terminate(); // TODO: discuss if and how this should be open API
 }